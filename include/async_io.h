@@ -0,0 +1,148 @@
+#ifndef ASYNC_IO_H
+#define ASYNC_IO_H
+
+#include <cstdint>
+#include <cstddef>
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+#include <sys/uio.h>
+#include "config.h"
+
+// 一个异步块请求：对 [start_block, start_block + count) 做一次读或写
+struct BlockRequest
+{
+    enum Op
+    {
+        READ,
+        WRITE
+    };
+
+    Op op = READ;
+    int start_block = 0;
+    int count = 1;
+    char *buf = nullptr;          // READ 的目标缓冲区 / WRITE 的数据源 (写时只读)
+    std::uint64_t user_data = 0;  // 原样带回完成项
+    std::function<void(const BlockRequest &req, bool ok)> callback; // 可选，在 poll/drain 的线程中调用
+};
+
+// 完成队列中的一项
+struct BlockCompletion
+{
+    std::uint64_t user_data = 0;
+    bool ok = false;
+};
+
+// 异步块 I/O 引擎
+// - 优先使用 io_uring (直接通过系统调用，不依赖 liburing)
+// - io_uring 不可用时退化为线程池 + pread/pwrite
+// - 在途请求数不超过队列深度，满时 submit 会先回收完成项
+class AsyncIOEngine
+{
+public:
+    struct Stats
+    {
+        std::size_t submitted = 0;
+        std::size_t completed = 0;
+        std::size_t failed = 0;
+        std::size_t batches = 0;             // submit 调用次数
+        std::uint64_t total_latency_us = 0;  // 提交到完成的累计时延
+        std::uint64_t max_latency_us = 0;
+
+        double avgLatencyUs() const { return completed ? double(total_latency_us) / completed : 0.0; }
+    };
+
+    // prefer_io_uring 为 false 时直接使用线程池
+    AsyncIOEngine(int fd, unsigned queue_depth = ASYNC_QUEUE_DEPTH, bool prefer_io_uring = true);
+    ~AsyncIOEngine();
+
+    AsyncIOEngine(const AsyncIOEngine &) = delete;
+    AsyncIOEngine &operator=(const AsyncIOEngine &) = delete;
+
+    bool usingIoUring() const { return ring_fd >= 0; }
+    unsigned queueDepth() const { return queue_depth; }
+    unsigned inFlight() const { return in_flight; }
+
+    // 提交一批请求，返回成功入队的请求数
+    int submit(const std::vector<BlockRequest> &batch);
+
+    // 回收已完成的请求；wait 为 true 时至少等到一个完成 (有在途请求时)
+    // 完成项追加到 out (可为空)，返回回收的数量
+    int poll(std::vector<BlockCompletion> *out, bool wait);
+
+    // 等待全部在途请求完成
+    void drain(std::vector<BlockCompletion> *out = nullptr);
+
+    const Stats &stats() const { return stats_; }
+    void resetStats() { stats_ = Stats{}; }
+
+private:
+    using Clock = std::chrono::steady_clock;
+
+    struct Slot
+    {
+        BlockRequest req;
+        Clock::time_point submit_time;
+        Clock::time_point done_time;
+        std::size_t done = 0; // 已完成的字节数 (处理短读写)
+        bool ok = false;
+        bool busy = false;
+    };
+
+    int fd;
+    unsigned queue_depth;
+    unsigned in_flight = 0;
+    std::vector<Slot> slots;
+    std::vector<unsigned> free_slots;
+    std::vector<BlockCompletion> completions; // 已回收但尚未交给调用者的完成项
+    Stats stats_;
+
+    // ---- io_uring ----
+    int ring_fd = -1;
+    void *sq_ptr = nullptr;
+    void *cq_ptr = nullptr;
+    void *sqes_ptr = nullptr;
+    std::size_t sq_map_size = 0;
+    std::size_t cq_map_size = 0;
+    std::size_t sqes_map_size = 0;
+    unsigned *sq_head = nullptr;
+    unsigned *sq_tail = nullptr;
+    unsigned *sq_mask = nullptr;
+    unsigned *sq_array = nullptr;
+    unsigned *cq_head = nullptr;
+    unsigned *cq_tail = nullptr;
+    unsigned *cq_mask = nullptr;
+    void *cqes = nullptr;
+    std::vector<iovec> iovecs; // 每个槽位一个 iovec
+
+    bool setupRing_();
+    void teardownRing_();
+    bool queueRing_(unsigned slot);
+    // 把 SQ 中排队的请求交给内核；内核拒收的请求撤回并同步完成
+    void flushRing_();
+    int reapRing_(bool wait);
+
+    // ---- 线程池 ----
+    std::vector<std::thread> workers;
+    std::mutex mtx;
+    std::condition_variable work_cv;
+    std::condition_variable done_cv;
+    std::deque<unsigned> pending;
+    std::deque<unsigned> finished;
+    bool stopping = false;
+
+    void startWorkers_();
+    void stopWorkers_();
+    void workerLoop_();
+    int reapPool_(bool wait);
+
+    // 同步完成剩余字节 (pread/pwrite)，返回是否全部完成
+    bool finishSync_(Slot &s);
+    void complete_(unsigned slot);
+};
+
+#endif // ASYNC_IO_H
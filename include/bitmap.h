@@ -0,0 +1,81 @@
+#ifndef BITMAP_H
+#define BITMAP_H
+
+#include <cstdint>
+#include <cstddef>
+#include <vector>
+
+// 按位压缩的位图 (每个 uint64_t 存 64 位)
+// - 查找空闲位按字扫描，用 ctz 直接定位，popcount 统计已用数量
+// - allocate 采用 next-fit：从上次分配的位置继续找，到末尾后回绕
+// - 磁盘编码：第 i 位存放在第 i / 8 个字节的第 i % 8 位，与主机字节序无关
+// - 按 chunk_bytes 字节 (通常为一个磁盘块) 分段记录脏标志，保存时只需写回改动过的段
+class Bitmap
+{
+public:
+    explicit Bitmap(int bits = 0, int chunk_bytes = 4096);
+
+    void resize(int bits);
+    int size() const { return bits; }
+
+    bool test(int i) const { return (words[i >> 6] >> (i & 63)) & 1u; }
+    void set(int i)
+    {
+        words[i >> 6] |= (std::uint64_t(1) << (i & 63));
+        dirty[chunkOf_(i)] = 1;
+    }
+    void clear(int i)
+    {
+        words[i >> 6] &= ~(std::uint64_t(1) << (i & 63));
+        dirty[chunkOf_(i)] = 1;
+    }
+
+    // 全部清 0 (所有段变脏)，并重置 next-fit 游标
+    void clearAll();
+    // 将 [first, first + count) 置 1
+    void setRange(int first, int count);
+
+    // 已置位的数量
+    int count() const;
+
+    // 在 [lo, hi) 中查找第一个 0 位，找不到返回 -1
+    int findZero(int lo, int hi) const;
+    // 在 [lo, hi) 中查找第一个 1 位，找不到返回 hi
+    int findOne(int lo, int hi) const;
+
+    // next-fit 分配：从游标开始在 [lo, hi) 中找 0 位并置 1，找不到返回 -1
+    int allocate(int lo, int hi);
+
+    // 连续分配：在 [lo, hi) 中分配一段最多 want 个连续的 0 位并置 1
+    // 优先从 goal 处向后延伸；否则 next-fit 找第一段足够长的；都没有则取最长的一段
+    // 返回起始位置 (失败 -1)，实际长度写入 *got
+    int allocateRun(int lo, int hi, int goal, int want, int *got);
+
+    // 编码后占用的字节数
+    std::size_t byteSize() const { return (static_cast<std::size_t>(bits) + 7) / 8; }
+    // 与磁盘格式互转，len 不足 byteSize() 时多出的位视为 0
+    void toBytes(char *out, std::size_t len) const;
+    // fromBytes 之后所有段视为干净
+    void fromBytes(const char *in, std::size_t len);
+
+    // --- 分段脏标志 ---
+    int chunkBytes() const { return chunk_bytes; }
+    int chunkCount() const { return static_cast<int>(dirty.size()); }
+    bool chunkDirty(int c) const { return dirty[c] != 0; }
+    bool anyDirty() const;
+    void markAllDirty();
+    void clearDirty();
+    // 第 c 段的磁盘编码，写入 out (chunkBytes() 字节，超出位图的部分为 0)
+    void chunkToBytes(int c, char *out) const;
+
+private:
+    int bits;
+    int chunk_bytes;
+    int cursor = 0; // next-fit 游标
+    std::vector<std::uint64_t> words;
+    std::vector<char> dirty; // 每段一个标志
+
+    int chunkOf_(int i) const { return (i >> 3) / chunk_bytes; }
+};
+
+#endif // BITMAP_H
@@ -0,0 +1,102 @@
+#ifndef BUFFER_CACHE_H
+#define BUFFER_CACHE_H
+
+#include <list>
+#include <unordered_map>
+#include <vector>
+#include <cstddef>
+#include "disk_manager.h"
+#include "config.h"
+
+// 块缓冲缓存：位于 FileSystem 与 DiskManager 之间
+// - LRU 淘汰，容量可配置
+// - 写回(write-back)：写操作只修改内存中的块并标记为脏，淘汰或 flush 时才落盘
+class BufferCache
+{
+public:
+    struct Stats
+    {
+        std::size_t hits = 0;       // 命中次数
+        std::size_t misses = 0;     // 未命中次数 (需要读盘)
+        std::size_t writebacks = 0; // 脏块写回次数
+        std::size_t evictions = 0;  // 淘汰次数
+    };
+
+    explicit BufferCache(DiskManager &disk, std::size_t capacity = BUFFER_CACHE_BLOCKS);
+    ~BufferCache();
+
+    // 读取一个块 (命中时直接从内存复制)
+    bool readBlock(int block_id, char *buf);
+
+    // 写入一个块 (只写缓存并标记为脏)
+    bool writeBlock(int block_id, const char *buf);
+
+    // 批量读写：block_ids[i] 对应 buf + i * BLOCK_SIZE
+    // 未命中的块交给 DiskManager::readBlocks 合并读取；返回成功的块数
+    int readBlocks(const std::vector<int> &block_ids, char *buf, std::vector<bool> *status = nullptr);
+    int writeBlocks(const std::vector<int> &block_ids, const char *buf, std::vector<bool> *status = nullptr);
+
+    // 直写：交给 DiskManager::writeBlocks 合并写盘，不占新的缓存槽；已在缓存中的块同步更新内容并变为干净
+    // 写盘失败的块退回普通的缓存写
+    int writeBlocksThrough(const std::vector<int> &block_ids, const char *buf);
+
+    // 把不在缓存中的块一次性读入缓存 (连续块合并读取)，MMAP 后端无需预读
+    void prefetch(const std::vector<int> &block_ids);
+
+    // 钉住一个块并返回其只读数据 (失败返回 nullptr)，用 unpinBlock 释放
+    // - 钉住的块不会被淘汰，指针在 unpin 之前一直有效
+    // - 块不在缓存中且磁盘为 MMAP 后端时直接返回映射区地址，不占缓存槽，*pinned 置为 false (无需 unpin)
+    const char *pinBlock(int block_id, bool *pinned);
+    void unpinBlock(int block_id);
+
+    // 丢弃某个块的缓存内容，不写回 (块已被释放，内容不再需要)
+    // 块被钉住时只清除脏标志，缓存槽留到 unpin 之后再随 LRU 淘汰
+    void discard(int block_id);
+
+    // 在缓存中放入一个全 0 的块而不读盘
+    // dirty 为 false 时调用者需保证磁盘上该块本来就是 0
+    void installZeroBlock(int block_id, bool dirty);
+
+    // 将所有脏块按块号排序后批量写回磁盘 (相邻块合并为一次写)
+    // skip_pinned 为 true 时跳过被钉住的脏块 (日志中尚未提交的元数据)
+    bool flush(bool skip_pinned = false);
+
+    // 如果该块在缓存中且是脏的，立即写回
+    bool writeBackBlock(int block_id);
+
+    // 丢弃全部缓存内容，不写回 (格式化时使用)
+    void invalidate();
+
+    // 调整容量，必要时立即淘汰多余的块
+    void setCapacity(std::size_t capacity);
+    std::size_t capacity() const { return capacity_; }
+    std::size_t size() const { return lru_.size(); }
+
+    const Stats &stats() const { return stats_; }
+    void resetStats() { stats_ = Stats{}; }
+
+private:
+    struct Buffer
+    {
+        int block_id = -1;
+        bool dirty = false;
+        int pins = 0; // 大于 0 时不会被淘汰
+        char data[BLOCK_SIZE];
+    };
+
+    DiskManager &disk;
+    std::size_t capacity_;
+    std::list<Buffer> lru_; // 头部为最近使用
+    std::unordered_map<int, std::list<Buffer>::iterator> index_;
+    Stats stats_;
+
+    // 查找块并移到 LRU 头部，未命中返回 nullptr
+    Buffer *lookup_(int block_id);
+    // 为块分配一个新的缓存槽 (必要时淘汰)，内容未初始化
+    Buffer *insert_(int block_id);
+    // 淘汰 LRU 尾部最旧的未钉住的块，脏块先写回
+    bool evictOne_();
+    bool writeBack_(Buffer &b);
+};
+
+#endif // BUFFER_CACHE_H
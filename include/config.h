@@ -8,7 +8,23 @@ const int BLOCK_SIZE = 1024;              // 块大小 (1KB)
 const int DISK_BLOCKS = 10240;            // 虚拟磁盘总块数 (10MB)
 const std::string DISK_PATH = "disk.img"; // 虚拟磁盘文件路径
 
+// ================== 缓存配置 ==================
+const int BUFFER_CACHE_BLOCKS = 256; // 块缓冲缓存容量 (块数, 256KB)
+const int DISCARD_BATCH_BLOCKS = 64; // 释放块累计到该数量时批量打洞
+const int INODE_CACHE_ENTRIES = 512; // inode 缓存容量 (个)
+const int DENTRY_CACHE_ENTRIES = 1024; // 目录项缓存容量 (个，含负缓存)
+const int READ_VIEW_BYTES = 64 * 1024;   // 顺序读取时每个只读视图覆盖的字节数 (同时钉住的块数有上限)
+const int WRITE_THROUGH_BLOCKS = 32; // 一次写入中整块覆盖的块数达到该值时绕过缓存直接批量写盘
+const int BMAP_CACHE_BLOCKS = 16;    // 间接指针块缓存容量 (块数，按块号直接映射)
+
+// ================== 异步 I/O 配置 ==================
+const unsigned ASYNC_QUEUE_DEPTH = 32; // 异步引擎最大在途请求数 (0 表示禁用)
+const unsigned ASYNC_MAX_QUEUE_DEPTH = 4096; // 队列深度上限 (io_uring 单环最多 32768 项，槽位数组也按此分配)
+const int ASYNC_POOL_THREADS = 4;      // io_uring 不可用时线程池的线程数
+
 // ================== 文件系统布局配置 ==================
+// 磁盘格式版本：1 = 位图按位存储，2 = inode 含二级间接指针，3 = 小文件内联，4 = 变长目录项，5 = 元数据日志
+const int FS_VERSION = 5;
 const int BOOT_BLOCK_COUNT = 1;    // 引导块数量
 const int SUPER_BLOCK_COUNT = 1;   // 超级块数量
 const int INODE_BITMAP_BLOCKS = 1; // inode位图所占块数
@@ -26,12 +42,24 @@ const int DATA_BITMAP_START = INODE_BITMAP_START + INODE_BITMAP_BLOCKS;
 const int INODE_AREA_START = DATA_BITMAP_START + DATA_BITMAP_BLOCKS;
 const int DATA_AREA_START = INODE_AREA_START + INODE_AREA_BLOCKS;
 
+// 持久化策略 PERIODIC 的默认刷新间隔 (毫秒)，可用 mount -o flush=毫秒 修改
+const int FLUSH_INTERVAL_MS = 5000;
+
+// 元数据日志区 (位于磁盘末尾，在数据位图中标记为已占用)
+const int JOURNAL_BLOCKS = 512;        // 日志区块数
+const int JOURNAL_COMMIT_BLOCKS = 64;  // 当前事务累计这么多元数据块时，在操作结束时提交
+
 // 总inode数量
 const int TOTAL_INODES = INODE_AREA_BLOCKS * INODES_PER_BLOCK;
 
+static_assert(TOTAL_INODES <= INODE_BITMAP_BLOCKS * BLOCK_SIZE * 8, "inode bitmap too small");
+static_assert(DISK_BLOCKS <= DATA_BITMAP_BLOCKS * BLOCK_SIZE * 8, "data bitmap too small");
+
 // ================== Inode 配置 ==================
 const int DIRECT_BLOCKS = 10;                            // 直接数据块指针数量
 const int INDIRECT_BLOCK_1 = 1;                          // 一级间接数据块指针数量
 const int POINTERS_PER_BLOCK = BLOCK_SIZE / sizeof(int); // 每个块中可以存放的指针数量
+// 块映射 (直接 + 一级间接 + 二级间接) 能表示的最大逻辑块数
+const int MAX_MAPPED_BLOCKS = DIRECT_BLOCKS + POINTERS_PER_BLOCK + POINTERS_PER_BLOCK * POINTERS_PER_BLOCK;
 
 #endif // CONFIG_H
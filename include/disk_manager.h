@@ -3,15 +3,28 @@
 
 #include <string>
 #include <fstream>
+#include <vector>
+#include <memory>
+#include <cstddef>
+#include "async_io.h"
 #include "config.h"
 
+// 磁盘后端类型
+enum class DiskBackend
+{
+    STREAM, // std::fstream 逐块 seek + read/write
+    MMAP    // mmap 映射整个磁盘文件，读写即 memcpy，由内核页缓存负责落盘
+};
+
 class DiskManager
 {
 public:
-    DiskManager();
+    explicit DiskManager(DiskBackend backend = DiskBackend::STREAM);
     ~DiskManager();
 
-    // 创建并初始化虚拟磁盘文件
+    DiskBackend getBackend() const { return backend; }
+
+    // 创建虚拟磁盘文件 (稀疏文件，所有块初始为 0，不实际写盘)
     void createDisk();
 
     // 检查磁盘文件是否存在
@@ -23,8 +36,57 @@ public:
     // 将缓冲区的数据写入指定块号
     bool writeBlock(int block_id, const char *buf);
 
+    // 批量读写：block_ids[i] 对应 buf + i * BLOCK_SIZE
+    // 列表中相邻的连续块号会合并成一次 pread/pwrite (MMAP 后端为一次 memcpy)
+    // status 非空时逐块返回成功与否；返回值为成功的块数
+    int readBlocks(const std::vector<int> &block_ids, char *buf, std::vector<bool> *status = nullptr);
+    int writeBlocks(const std::vector<int> &block_ids, const char *buf, std::vector<bool> *status = nullptr);
+
+    // 连续区间 [start_block, start_block + count) 的读写，成功返回 true
+    bool readBlocks(int start_block, int count, char *buf);
+    bool writeBlocks(int start_block, int count, const char *buf);
+
+    // 释放一批块占用的宿主机空间 (block_ids 需升序)
+    // 相邻块合并为一次 fallocate(PUNCH_HOLE)，不支持打洞时退化为写 0；返回成功的块数
+    int discardBlocks(const std::vector<int> &block_ids);
+
+    // 落盘点：STREAM 刷新流缓冲并 fdatasync，MMAP 执行 msync
+    bool flush();
+
+    // MMAP 后端下返回块在映射区中的地址，STREAM 后端返回 nullptr
+    const char *mappedBlock(int block_id) const;
+
+    // 异步引擎 (仅 STREAM 后端；MMAP 后端读写本身就是内存拷贝)
+    // 批量读写中不连续的多段会作为一批请求同时在途
+    AsyncIOEngine *asyncEngine() { return engine.get(); }
+    const AsyncIOEngine *asyncEngine() const { return engine.get(); }
+    // 调整队列深度，0 表示关闭异步引擎
+    void setAsyncQueueDepth(unsigned depth);
+
 private:
-    std::fstream disk_file; // 磁盘文件流
+    DiskBackend backend;
+    std::fstream disk_file; // 磁盘文件流 (STREAM 后端的单块读写)
+
+    // 原始文件描述符：批量读写使用，MMAP 后端也由它建立映射
+    int disk_fd = -1;
+    char *disk_map = nullptr;
+    std::size_t map_size = 0;
+
+    unsigned async_depth = ASYNC_QUEUE_DEPTH;
+    std::unique_ptr<AsyncIOEngine> engine;
+
+    bool isOpen_() const;
+    bool openFd_();
+    // 映射整个磁盘文件 (文件偏短时先补足长度)，失败返回 false
+    bool openMapping_();
+    // 无法映射时改用 STREAM 后端
+    void fallBackToStream_();
+    void closeFd_();
+    // 对一段连续块做一次读/写
+    bool readRun_(int start_block, int count, char *buf);
+    bool writeRun_(int start_block, int count, const char *buf);
+    // 把 block_ids 切分成连续区间并完成读/写，多段时交给异步引擎并发执行
+    int transferRuns_(BlockRequest::Op op, const std::vector<int> &block_ids, char *buf, std::vector<bool> *status);
 };
 
 struct FD
@@ -2,10 +2,18 @@
 #define FILE_SYSTEM_H
 
 #include <string>
+#include <string_view>
 #include <vector>
+#include <set>
+#include <cstdint>
+#include <functional>
+#include <unordered_map>
 #include <ctime>
+#include <chrono>
 #include <cstddef>
 #include "disk_manager.h"
+#include "buffer_cache.h"
+#include "bitmap.h"
 #include "config.h"
 
 // 文件类型
@@ -15,6 +23,24 @@ enum FileType
     DIRECTORY
 };
 
+// 区段 (extent)：逻辑块 [e_logical, e_logical + e_len) 对应物理块 [e_start, e_start + e_len)
+struct Extent
+{
+    int e_logical; // 起始逻辑块号
+    int e_start;   // 起始物理块号
+    int e_len;     // 块数，0 表示该槽位未使用
+};
+
+// inode 标志
+const int INODE_EXTENTS = 1 << 0;     // 使用区段映射 (i_extents) 而不是直接/间接块
+const int INODE_INLINE_DATA = 1 << 1; // 数据直接存放在 inode 的块映射区 (i_inline)，没有数据块
+const int INODE_DIR_INDEX = 1 << 2;   // 目录带哈希索引 (第 0 块为索引根，其余块为叶子)
+
+// 块映射区的大小：inode 中除去头部字段和 i_flags 后剩余的全部空间
+const int INODE_MAP_BYTES = INODE_SIZE - 40 - static_cast<int>(sizeof(int));
+const int INODE_EXTENT_SLOTS = INODE_MAP_BYTES / static_cast<int>(sizeof(Extent));
+const int INODE_INLINE_SIZE = INODE_MAP_BYTES; // 内联数据的最大字节数
+
 // Inode 结构
 struct Inode
 {
@@ -25,11 +51,24 @@ struct Inode
     time_t i_atime;              // 最后访问时间
     time_t i_mtime;              // 最后修改时间
     time_t i_ctime;              // 创建时间
-    int i_direct[DIRECT_BLOCKS]; // 直接数据块指针
-    int i_indirect1;             // 一级间接数据块指针
-    // 为了简化，不实现二级间接指针
+    // 块映射：i_flags 决定使用哪一种解释
+    union
+    {
+        struct
+        {
+            int i_direct[DIRECT_BLOCKS]; // 直接数据块指针
+            int i_indirect1;             // 一级间接数据块指针
+            int i_indirect2;             // 二级间接数据块指针 (版本 2 起有效)
+        };
+        Extent i_extents[INODE_EXTENT_SLOTS]; // 按 e_logical 升序排列的区段
+        char i_inline[INODE_INLINE_SIZE];     // 内联数据，i_size 之后的字节保持为 0
+        char i_map_area[INODE_MAP_BYTES];
+    };
+    int i_flags; // inode 标志 (位于 inode 槽末尾，旧磁盘上为 0)
 };
 
+static_assert(sizeof(Inode) == INODE_SIZE, "Inode must fill its on-disk slot");
+
 // 超级块 结构
 struct SuperBlock
 {
@@ -41,19 +80,157 @@ struct SuperBlock
     int s_data_bitmap_start;
     int s_inode_area_start;
     int s_data_area_start;
+    // 延迟初始化 (仅当 s_flags 含 SB_LAZY_INIT 时有效；旧磁盘这些字段为 0)
+    int s_flags;
+    int s_itable_init_blocks; // inode 表中已初始化的块数，之后的块从未写过，读出全 0
+    int s_data_high_water;    // 曾经分配过的最大数据块号 + 1，之后的块从未写过
+    int s_version;            // 磁盘格式版本 (旧磁盘为 0)
+    int s_journal_start;      // 日志区起始块号 (版本 5 起；0 表示没有日志)
+    int s_journal_blocks;     // 日志区块数
 };
 
-// 目录项 结构
+// 超级块标志
+const int SB_LAZY_INIT = 1 << 0; // 格式化时只初始化元数据，其余区域按需初始化
+
+// 元数据日志 (JBD 风格的重做日志，只记录元数据块)
+// - 日志区第 0 块是日志超级块，h_seq 为下一个待重放事务的序号；事务从日志区第 1 块起顺序存放
+// - 一个事务：若干描述块 (列出原位置块号，紧跟对应块的内容) + 提交块 (含校验和)
+// - 挂载时重放序号连续且校验和正确的事务，然后清空日志；撤销记录防止已释放块的旧副本被重放
+struct JournalHeader
+{
+    uint32_t h_magic;
+    uint32_t h_type;  // JOURNAL_SUPER / JOURNAL_DESCRIPTOR / JOURNAL_COMMIT
+    uint32_t h_seq;   // 事务序号
+    uint32_t h_count; // 描述块：本块的标签数；提交块：事务内容块总数
+};
+
+const uint32_t JOURNAL_MAGIC = 0x4c4e524a; // "JRNL"
+const uint32_t JOURNAL_SUPER = 1;
+const uint32_t JOURNAL_DESCRIPTOR = 2;
+const uint32_t JOURNAL_COMMIT = 3;
+// 描述块中 JournalHeader 之后是 uint32_t 标签：原位置块号，带撤销位时表示撤销 (后面没有内容块)
+const int JOURNAL_TAGS_PER_BLOCK = static_cast<int>((BLOCK_SIZE - sizeof(JournalHeader)) / sizeof(uint32_t));
+const uint32_t JOURNAL_TAG_REVOKE = 0x80000000u;
+
+// 目录项 结构 (版本 4 起为变长记录，ext2 风格)
+// - 记录头之后紧跟文件名 (不以 0 结尾)，记录按 4 字节对齐
+// - 一个目录块 (或内联目录区) 由若干记录首尾相接完整覆盖，
+//   删除的记录并入前一条记录的 d_rec_len，插入时从记录尾部的空闲空间切分
 struct DirEntry
+{
+    int d_inode_id;       // inode号，-1 表示空记录
+    uint16_t d_rec_len;   // 本记录占用的字节数 (含尾部空闲空间)
+    uint8_t d_name_len;   // 文件名长度
+    uint8_t d_type;       // 文件类型 (FileType)
+};
+
+const int DIR_ENTRY_HEADER = static_cast<int>(sizeof(DirEntry));
+const int DIR_NAME_MAX = 255;
+
+// 存放文件名需要的最小记录长度
+inline int dirRecLen(int name_len)
+{
+    return (DIR_ENTRY_HEADER + name_len + 3) & ~3;
+}
+
+// 哈希目录索引 (htree 风格，单层)
+// - 第 0 块依次为 "."、".." 两条记录和一条覆盖块内剩余空间的空记录，索引根就藏在这条空记录里，
+//   不认识索引的代码把它当普通目录块遍历，结果不变
+// - 索引项按哈希升序排列：第 i 项表示哈希落在 [dx_hash, 下一项的 dx_hash) 的目录项都在逻辑块 dx_block
+// - 查找、插入、删除都只需读索引根和一个叶子块
+struct DirIndexRoot
+{
+    uint32_t dx_magic;
+    uint16_t dx_count; // 已用索引项数
+    uint16_t dx_limit; // 索引项容量
+};
+
+struct DirIndexEntry
+{
+    uint32_t dx_hash;  // 该叶子块中最小的哈希 (第 0 项为 0)
+    uint32_t dx_block; // 叶子的逻辑块号
+};
+
+const uint32_t DIR_INDEX_MAGIC = 0x31495844; // "DXI1"
+
+// 版本 4 之前的定长目录项，仅用于挂载旧磁盘时转换
+struct LegacyDirEntry
 {
     char d_name[252]; // 文件名
     int d_inode_id;   // inode号
 };
 
+// atime 更新策略 (对应 mount -o strictatime / relatime / noatime)
+enum class AtimeMode
+{
+    STRICT,   // 每次读都更新 atime
+    RELATIME, // 仅当 atime 不晚于 mtime/ctime，或距上次更新超过 RELATIME_INTERVAL 时更新
+    NOATIME   // 读不更新 atime
+};
+
+const int RELATIME_INTERVAL = 24 * 60 * 60; // 秒
+
+// 持久化策略 (对应 mount -o sync / flush=毫秒 / noflush)
+// 无论哪种策略，sync / sys_fsync / sys_fdatasync / 卸载都会立即落盘
+enum class FlushPolicy
+{
+    SYNC,     // 每个修改操作结束时落盘
+    PERIODIC, // 距上次落盘超过 flush_interval_ms 时，在操作结束或 tick() 时落盘
+    UNMOUNT   // 不主动落盘 (日志事务过大时仍会提交)
+};
+
+// 挂载选项
+struct MountOptions
+{
+    AtimeMode atime = AtimeMode::RELATIME;
+    bool lazytime = false; // 时间戳更新只留在内存中，仅在 sync / 卸载 / inode 淘汰时写回
+    FlushPolicy flush = FlushPolicy::PERIODIC;
+    int flush_interval_ms = FLUSH_INTERVAL_MS;
+};
+
+// sys_fstat 的结果
+struct FileStat
+{
+    int ino;
+    int type; // FileType
+    std::size_t size;
+    int blocks; // 占用的数据块数
+    time_t atime;
+    time_t mtime;
+    time_t ctime;
+};
+
+// 文件某一范围的只读视图 (FileSystem::readView 填充)
+// - 各段直接指向缓存块 (或 MMAP 映射区)，不复制数据；物理上相邻的块合并成一段
+// - 视图存活期间引用的缓存块被钉住不会淘汰，析构或 release 时释放
+// - 视图只在下一次修改该文件之前有意义，不要跨写操作持有
+class FileReadView
+{
+public:
+    FileReadView() = default;
+    ~FileReadView() { release(); }
+    FileReadView(const FileReadView &) = delete;
+    FileReadView &operator=(const FileReadView &) = delete;
+    FileReadView(FileReadView &&other) noexcept;
+    FileReadView &operator=(FileReadView &&other) noexcept;
+
+    const std::vector<std::string_view> &segments() const { return segments_; }
+    std::size_t size() const { return size_; }
+    void release();
+
+private:
+    friend class FileSystem;
+    BufferCache *cache_ = nullptr;
+    std::vector<std::string_view> segments_;
+    std::vector<int> pinned_;     // 需要 unpin 的块
+    std::vector<char> inline_;    // 内联文件的数据副本 (最多 INODE_INLINE_SIZE 字节)
+    std::size_t size_ = 0;
+};
+
 class FileSystem
 {
 public:
-    FileSystem();
+    explicit FileSystem(DiskBackend backend = DiskBackend::STREAM);
     ~FileSystem();
 
     // 格式化文件系统
@@ -62,6 +239,10 @@ public:
     // 挂载文件系统 (加载超级块等信息)
     void mount();
 
+    // 挂载选项，可随时修改
+    const MountOptions &mountOptions() const { return mount_opts_; }
+    void setMountOptions(const MountOptions &opts) { mount_opts_ = opts; }
+
     // 创建文件
     int createFile(const std::string &path);
 
@@ -71,12 +252,15 @@ public:
     // 打开文件 (返回inode id)
     int openFile(const std::string &path);
 
-    // 关闭文件 (当前实现中无需太多操作)
+    // 关闭文件 (释放 openFile 对 inode 缓存项的固定)
     void closeFile(int inode_id);
 
     // 读取文件
     int readFile(int inode_id, char *buf, int size, int offset);
 
+    // 零拷贝读取：把 [offset, offset + size) 的数据以只读视图的形式交给调用者，返回视图字节数 (失败 -1)
+    int readView(int inode_id, int offset, int size, FileReadView &view);
+
     // 写入文件
     int writeFile(int inode_id, const char *buf, int size, int offset);
 
@@ -92,12 +276,38 @@ public:
     // 列出目录内容
     void listDirectory(const std::string &path);
 
-    // 获取当前工作目录
-    std::string getCurrentPath() const;
+    // 获取当前工作目录 (结果缓存，切换目录或删除目录项后才重新计算)
+    const std::string &getCurrentPath() const;
 
     // 切换目录
     void changeDirectory(const std::string &path);
 
+    // 将缓存中的脏块写回磁盘并落盘 (MMAP 后端执行 msync)
+    // 有日志时只需提交当前事务：元数据写进日志即已持久，原位置的写回留给检查点
+    void sync();
+
+    // 由主循环定时调用：PERIODIC 策略下距上次落盘超过间隔时落盘 (文件系统不是线程安全的，不另开刷新线程)
+    void tick();
+
+    // 块缓存统计 (命中/未命中/写回/淘汰)
+    const BufferCache::Stats &cacheStats() const { return cache.stats(); }
+    std::size_t cacheSize() const { return cache.size(); }
+    std::size_t cacheCapacity() const { return cache.capacity(); }
+    void setCacheCapacity(std::size_t blocks) { cache.setCapacity(blocks); }
+    std::size_t inodeCacheSize() const { return icache_.size(); }
+    // 目录项缓存统计
+    struct DentryStats
+    {
+        std::size_t hits = 0;
+        std::size_t misses = 0;
+    };
+    const DentryStats &dentryStats() const { return dcache_stats_; }
+    std::size_t dentryCacheSize() const { return dcache_size_; }
+
+    // 异步块引擎 (可能为空) 与队列深度设置
+    const AsyncIOEngine *asyncEngine() const { return disk.asyncEngine(); }
+    void setAsyncQueueDepth(unsigned depth) { disk.setAsyncQueueDepth(depth); }
+
     // 简化版 open 标志
     enum OpenFlag
     {
@@ -109,6 +319,23 @@ public:
         O_APPEND = 1 << 4
     };
 
+    // sys_lseek 的 whence (不用 SEEK_* 以免与 <cstdio> 的宏冲突)
+    enum SeekWhence
+    {
+        FS_SEEK_SET,
+        FS_SEEK_CUR,
+        FS_SEEK_END,
+        FS_SEEK_DATA, // 定位到 offset 之后 (含) 第一段数据的开头
+        FS_SEEK_HOLE  // 定位到 offset 之后 (含) 第一个空洞的开头，文件末尾也算空洞
+    };
+
+    // sys_fallocate 的 mode (可组合)
+    enum FallocMode
+    {
+        FS_FALLOC_KEEP_SIZE = 1 << 0, // 只预留块，不改变文件长度 (日志文件随后写进预留区)
+        FS_FALLOC_ZERO_RANGE = 1 << 1 // 区间内已有的数据也清零
+    };
+
     // 简化系统调用接口
     int sys_create(const std::string &path);
     int sys_open(const std::string &path, int flags);
@@ -116,6 +343,19 @@ public:
     std::ptrdiff_t sys_write(int fd, const std::string &data);
     int sys_close(int fd);
 
+    // 定位读写：直接使用调用方的缓冲区，不改变 fd 的当前偏移 (pwrite 也不受 O_APPEND 影响)
+    std::ptrdiff_t sys_pread(int fd, char *buf, std::size_t count, std::size_t offset);
+    std::ptrdiff_t sys_pwrite(int fd, const char *buf, std::size_t count, std::size_t offset);
+    // 返回新的偏移，失败 -1；允许定位到文件末尾之后
+    long sys_lseek(int fd, long offset, int whence);
+    int sys_fstat(int fd, FileStat &st);
+    // 返回时此前的写入都已落盘；fdatasync 不为只改了时间戳的 inode 落盘
+    int sys_fsync(int fd);
+    int sys_fdatasync(int fd);
+    // 为 [offset, offset + len) 中的空洞预先分配 (尽量连续的) 块，新块读出为 0；
+    // 之后写入该区间不再需要分配。空间不足时保留已分配的部分并返回 -1
+    int sys_fallocate(int fd, std::size_t offset, std::size_t len, int mode);
+
     int sys_mkdir(const std::string &path);
     int sys_rmdir(const std::string &path);
     int sys_rm(const std::string &path);
@@ -123,53 +363,208 @@ public:
 
 private:
     DiskManager disk;
+    BufferCache cache{disk}; // 所有块读写都经过缓存
     SuperBlock super_block;
-    bool inode_bitmap[TOTAL_INODES];
-    // 数据块位图较大，动态分配
-    bool *data_bitmap;
+    Bitmap inode_bitmap; // 按位压缩，磁盘上每个 inode 占 1 位
+    Bitmap data_bitmap;
     int current_dir_inode_id; // 当前目录的inode id
+    mutable std::string cwd_path_;     // getCurrentPath 的缓存结果
+    mutable bool cwd_path_valid_ = false;
 
     // 内部辅助函数
+    // 元数据只在同步点 (sync / format / 重新挂载 / 析构) 写回，且只写改动过的块
     void loadSuperBlock();
-    void saveSuperBlock();
+    void saveSuperBlock(); // 与上次写回的内容相同时跳过
     void loadBitmaps();
-    void saveBitmaps();
+    void saveBitmaps(); // 只写回脏的位图块
+    void syncMetadata_();
+    SuperBlock sb_on_disk_{}; // 上次读入/写回的超级块内容
+    bool mounted_ = false;
 
     int allocInode();
     void freeInode(int inode_id);
     int allocDataBlock();
+    // 分配最多 count 个连续数据块，尽量从 goal 开始；返回起始块号，实际块数写入 *got
+    int allocDataBlocks(int count, int goal, int *got);
     void freeDataBlock(int block_id);
+    // 新分配的块在缓存中清零 (无需读盘)
+    void prepareNewBlock_(int block_id);
 
+    // 已释放但尚未在磁盘上打洞的数据块 (有序，便于合并成连续区间)
+    std::set<int> pending_discard_;
+    void flushDiscards_();
+
+    // readInode / writeInode 只访问 inode 缓存，脏 inode 在同步点按 inode 表块批量写回
     Inode readInode(int inode_id);
     void writeInode(int inode_id, const Inode &inode);
 
+    // --- inode 缓存 ---
+    struct CachedInode
+    {
+        Inode inode;
+        int refcount = 0; // iget_ 持有数，大于 0 时不会被淘汰
+        bool dirty = false;
+        bool time_dirty = false; // lazytime 下仅时间戳有改动
+    };
+    std::unordered_map<int, CachedInode> icache_;
+    // 查找缓存项，未命中时从 inode 表读入
+    CachedInode &lookupInode_(int inode_id);
+    // 固定一个 inode 并返回其缓存副本的引用 (修改后需 writeInode 或标记脏)，用 iput_ 释放
+    Inode &iget_(int inode_id);
+    void iput_(int inode_id);
+    // 写回全部脏 inode，同一 inode 表块中的多个 inode 只写一次
+    // include_lazy 为 false 时，只有时间戳改动的 inode 仅在所在块本来就要写时顺带写回
+    void flushInodes_(bool include_lazy);
+    // 缓存满时：写回脏 inode 并丢弃所有未被固定的项
+    void shrinkInodeCache_();
+
+    MountOptions mount_opts_;
+    // 读访问后按挂载选项更新 atime
+    void updateAtime_(int inode_id);
+
+    // --- 块映射 (直接/间接块 / 区段) ---
+    // 逻辑块号 -> 物理块号，未映射返回 -1
+    int bmap_(const Inode &inode, int logical);
+    // 将逻辑块 [first, first + count) 映射到 phys；create 为 true 时为空洞分配 (尽量连续的) 新块
+    // 返回从 first 起成功映射的块数 (分配失败或超出映射能力时提前结束)
+    int mapBlocks_(Inode &inode, int first, int count, bool create, std::vector<int> &phys);
+    // 只读映射：phys[i] 为逻辑块 first + i 的物理块号，空洞为 -1
+    void mapRange_(const Inode &inode, int first, int count, std::vector<int> &phys);
+    // 从 logical 起第一个已映射 (mapped 为 true) 或未映射的逻辑块，找不到返回 end
+    int nextMapped_(const Inode &inode, int logical, int end, bool mapped);
+    // 记录逻辑块 logical 起 len 个块映射到物理块 start 起，返回实际记录的块数
+    int setMapping_(Inode &inode, int logical, int start, int len);
+    // 区段槽位用尽时转换为直接/间接块映射
+    bool extentsToBlockMap_(Inode &inode);
+    // 含逻辑块 logical 的末级指针块 (一级间接块或二级间接的叶子块) 及块内下标
+    // create 为 true 时按需分配指针块；不存在或分配失败返回 -1
+    int ptrBlockFor_(Inode &inode, int logical, bool create, int *index);
+    int newPtrBlock_(Inode &inode);
+
+    // 间接指针块缓存：按块号直接映射，写直达到块缓存，避免每次映射都复制整块
+    struct PtrBlock
+    {
+        int block_id = -1;
+        int ptrs[POINTERS_PER_BLOCK];
+    };
+    PtrBlock ptr_cache_[BMAP_CACHE_BLOCKS];
+    PtrBlock &loadPtrBlock_(int block_id);
+    void storePtrBlock_(const PtrBlock &pb);
+    void dropPtrBlock_(int block_id);
+    // 旧版本磁盘上非区段 inode 的 i_indirect2 位置是未初始化的填充，挂载时置为 -1
+    void upgradeInodes_();
+    // 释放 inode 映射的全部数据块并清空映射
+    void releaseBlocks_(Inode &inode);
+    // 内联文件增长超出 inode 时把数据搬到数据块 (改为区段映射)，空间不足返回 false
+    bool inlineToBlocks_(Inode &inode);
+
     // 路径解析，返回最后一个组件的父目录inode id和最后一个组件名
     int resolvePath(const std::string &path, std::string &last_component);
     // 根据路径查找inode
     int findInodeByPath(const std::string &path);
-    // 在指定目录inode下查找文件名对应的inode
+    // 在指定目录inode下查找文件名对应的inode (先查目录项缓存)
     int findInDir(int dir_inode_id, const std::string &filename);
+    // 不经缓存，直接读目录块查找
+    int lookupDirEntry_(Inode &dir, const std::string &filename);
     // 在指定目录inode下添加目录项
     bool addDirEntry(int dir_inode_id, const std::string &filename, int new_inode_id);
+
+    // 遍历目录中的有效目录项 (含 . 和 ..)；fn 返回 true 时停止遍历，并返回 true
+    bool forEachDirEntry_(const Inode &dir, const std::function<bool(const DirEntry &entry, const char *name)> &fn);
+    // 初始化一个新目录 (内联存放，只含 . 和 ..)
+    void initDirectory_(Inode &dir, int self_id, int parent_id);
+    // 内联目录放不下时搬到第一个目录块，空间不足返回 false
+    bool inlineDirToBlock_(Inode &dir);
+    // 旧磁盘上的定长目录项就地转换为变长记录
+    void upgradeDirectories_();
+    // --- 元数据日志 ---
+    // 元数据块 (超级块、位图、inode 表、目录块、间接指针块) 都经 writeMetaBlock_ 写入缓存并加入当前事务；
+    // 事务中的块被钉在缓存里，提交前不会写回原位置。事务在最外层操作结束时按需提交 (组提交)
+    bool journal_on_ = false;
+    uint32_t journal_seq_ = 1; // 下一个事务的序号
+    int journal_head_ = 1;     // 下一个事务在日志区中的起始位置
+    std::set<int> txn_blocks_; // 当前事务改动过的元数据块
+    std::set<int> txn_revoked_; // 当前事务释放的、日志中可能有旧副本的块
+    std::set<int> txn_freed_;   // 当前事务释放的数据区块，位图位保留到提交时才清除，提交前不会被再分配
+    std::set<int> journaled_;  // 上次检查点之后写进过日志的块
+    int op_depth_ = 0;
+    bool commit_pending_ = false;
+
+    // --- 持久化策略 ---
+    std::chrono::steady_clock::time_point last_flush_ = std::chrono::steady_clock::now();
+    bool data_dirty_ = false; // 上次落盘之后写过文件数据块
+
+    // 一次文件系统操作的范围 (可嵌套)，最外层结束时按持久化策略检查是否需要落盘
+    struct OpScope
+    {
+        explicit OpScope(FileSystem &owner) : fs(owner) { ++fs.op_depth_; }
+        ~OpScope()
+        {
+            if (--fs.op_depth_ == 0)
+                fs.opEnd_();
+        }
+        FileSystem &fs;
+    };
+
+    void writeMetaBlock_(int block_id, const char *buf);
+    // 释放块时调用：移出当前事务，日志中有旧副本的记下撤销
+    void journalForget_(int block_id);
+    void opEnd_();
+    bool flushDue_() const;
+    // 让此前的所有修改持久化：有日志时提交事务，否则把元数据和数据写回原位置
+    void writeBackAll_(bool include_lazy);
+    // 把内存中的元数据写入缓存并提交当前事务，只落盘一次
+    void commitJournal_(bool include_lazy);
+    // 已提交的块全部写回原位置，然后清空日志
+    void checkpointJournal_();
+    // 挂载时重放日志中已提交的事务
+    void recoverJournal_();
+    // 在磁盘末尾预留日志区并启用日志 (格式化或旧磁盘首次挂载时)，空间被占用时返回 false
+    bool createJournal_();
+    void writeJournalSuper_();
+
+    // --- 目录项缓存 ---
+    // (父目录 inode, 文件名) -> inode id，-1 为负缓存 (确认不存在)
+    // 按父目录分组，目录被删除 (inode 释放) 时整组丢弃；满了就全部清空
+    std::unordered_map<int, std::unordered_map<std::string, int>> dcache_;
+    std::size_t dcache_size_ = 0;
+    DentryStats dcache_stats_;
+    void dcacheSet_(int dir_inode_id, const std::string &name, int inode_id);
+    void dcacheDropDir_(int dir_inode_id);
+
+    // --- 哈希目录索引 ---
+    // 没有索引的目录：上次发现空闲空间的逻辑块号，插入时先试这一块
+    std::unordered_map<int, int> dir_slot_hint_;
+    // 读出索引根所在的第 0 块并校验，索引损坏时去掉索引标志 (退化为线性目录) 并返回 false
+    bool dxLoadRoot_(Inode &dir, char *root_buf);
+    // 在带索引的目录中查找，返回 inode id，找不到返回 -1
+    int dxFind_(Inode &dir, const char *root_buf, const std::string &name);
+    // 插入带索引的目录：1 成功，0 索引已满或无法分裂 (需退化为线性目录)，-1 空间不足
+    int dxAdd_(Inode &dir, char *root_buf, int inode_id, const std::string &name, int type);
+    // 只有一个目录块的线性目录写满时建立索引，同时插入新目录项
+    bool dxBuildIndex_(Inode &dir, int inode_id, const std::string &name, int type);
     // 在指定目录inode下删除目录项
     bool removeDirEntry(int dir_inode_id, const std::string &filename);
 
     // --- 文件描述符管理 ---
+    // 打开时解析一次路径，之后按 inode 读写 (inode 在打开期间固定在 inode 缓存中)
     struct FD
     {
-        std::string path;
+        int inode_id = -1;
         int flags = 0;
         std::size_t offset = 0;
         bool in_use = false;
 
         FD() = default;
-        FD(std::string p, int f, std::size_t off, bool in)
-            : path(std::move(p)), flags(f), offset(off), in_use(in) {}
+        FD(int ino, int f, std::size_t off, bool in)
+            : inode_id(ino), flags(f), offset(off), in_use(in) {}
     };
     std::vector<FD> fd_table_;
 
-    int alloc_fd_(const std::string &path, int flags, std::size_t offset);
+    int alloc_fd_(int inode_id, int flags, std::size_t offset);
     bool check_fd_(int fd) const;
+    // fd 有效且指向的文件仍然存在 (打开期间可能已被删除)
+    bool check_fd_inode_(int fd) const;
 
     // --- 在这里添加缺失的声明 ---
     void truncateFileData_(Inode &inode);
@@ -178,8 +573,6 @@ private:
     // 提示：将下列“假定存在的操作”替换为你实际已有的底层方法
     bool fs_path_exists_(const std::string &path, bool *is_dir = nullptr) const;
     bool fs_create_file_(const std::string &path);
-    bool fs_read_file_all_(const std::string &path, std::string &out) const;
-    bool fs_write_file_all_(const std::string &path, const std::string &data, bool truncate);
     bool fs_mkdir_(const std::string &path);
     bool fs_rmdir_(const std::string &path);
     bool fs_rm_(const std::string &path);
@@ -0,0 +1,405 @@
+#include "async_io.h"
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <linux/io_uring.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+AsyncIOEngine::AsyncIOEngine(int fd, unsigned queue_depth, bool prefer_io_uring)
+    : fd(fd), queue_depth(std::min(std::max(queue_depth, 1u), ASYNC_MAX_QUEUE_DEPTH))
+{
+    slots.resize(this->queue_depth);
+    iovecs.resize(this->queue_depth);
+    for (unsigned i = this->queue_depth; i > 0; --i)
+        free_slots.push_back(i - 1);
+
+    if (!prefer_io_uring || !setupRing_())
+        startWorkers_();
+}
+
+AsyncIOEngine::~AsyncIOEngine()
+{
+    drain();
+    if (usingIoUring())
+        teardownRing_();
+    else
+        stopWorkers_();
+}
+
+// ================= io_uring =================
+
+bool AsyncIOEngine::setupRing_()
+{
+    io_uring_params p;
+    memset(&p, 0, sizeof(p));
+    int rfd = static_cast<int>(syscall(__NR_io_uring_setup, queue_depth, &p));
+    if (rfd < 0)
+        return false; // 内核不支持或被禁用 (ENOSYS/EPERM)，改用线程池
+
+    sq_map_size = p.sq_off.array + p.sq_entries * sizeof(unsigned);
+    cq_map_size = p.cq_off.cqes + p.cq_entries * sizeof(io_uring_cqe);
+    bool single_mmap = (p.features & IORING_FEAT_SINGLE_MMAP) != 0;
+    if (single_mmap)
+        sq_map_size = cq_map_size = std::max(sq_map_size, cq_map_size);
+
+    sq_ptr = mmap(nullptr, sq_map_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, rfd, IORING_OFF_SQ_RING);
+    if (sq_ptr == MAP_FAILED)
+    {
+        sq_ptr = nullptr;
+        close(rfd);
+        return false;
+    }
+    if (single_mmap)
+    {
+        cq_ptr = sq_ptr;
+    }
+    else
+    {
+        cq_ptr = mmap(nullptr, cq_map_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, rfd, IORING_OFF_CQ_RING);
+        if (cq_ptr == MAP_FAILED)
+        {
+            cq_ptr = nullptr;
+            munmap(sq_ptr, sq_map_size);
+            sq_ptr = nullptr;
+            close(rfd);
+            return false;
+        }
+    }
+    sqes_map_size = p.sq_entries * sizeof(io_uring_sqe);
+    sqes_ptr = mmap(nullptr, sqes_map_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, rfd, IORING_OFF_SQES);
+    if (sqes_ptr == MAP_FAILED)
+    {
+        sqes_ptr = nullptr;
+        ring_fd = rfd;
+        teardownRing_();
+        return false;
+    }
+
+    char *sq = static_cast<char *>(sq_ptr);
+    char *cq = static_cast<char *>(cq_ptr);
+    sq_head = reinterpret_cast<unsigned *>(sq + p.sq_off.head);
+    sq_tail = reinterpret_cast<unsigned *>(sq + p.sq_off.tail);
+    sq_mask = reinterpret_cast<unsigned *>(sq + p.sq_off.ring_mask);
+    sq_array = reinterpret_cast<unsigned *>(sq + p.sq_off.array);
+    cq_head = reinterpret_cast<unsigned *>(cq + p.cq_off.head);
+    cq_tail = reinterpret_cast<unsigned *>(cq + p.cq_off.tail);
+    cq_mask = reinterpret_cast<unsigned *>(cq + p.cq_off.ring_mask);
+    cqes = cq + p.cq_off.cqes;
+    ring_fd = rfd;
+    return true;
+}
+
+void AsyncIOEngine::teardownRing_()
+{
+    if (sqes_ptr)
+        munmap(sqes_ptr, sqes_map_size);
+    if (cq_ptr && cq_ptr != sq_ptr)
+        munmap(cq_ptr, cq_map_size);
+    if (sq_ptr)
+        munmap(sq_ptr, sq_map_size);
+    sqes_ptr = cq_ptr = sq_ptr = nullptr;
+    if (ring_fd >= 0)
+        close(ring_fd);
+    ring_fd = -1;
+}
+
+bool AsyncIOEngine::queueRing_(unsigned slot)
+{
+    Slot &s = slots[slot];
+    std::size_t len = static_cast<std::size_t>(s.req.count) * BLOCK_SIZE;
+    iovecs[slot].iov_base = s.req.buf + s.done;
+    iovecs[slot].iov_len = len - s.done;
+
+    // 只有本线程写 sq_tail，直接读取即可
+    unsigned tail = *sq_tail;
+    unsigned index = tail & *sq_mask;
+    io_uring_sqe *sqe = static_cast<io_uring_sqe *>(sqes_ptr) + index;
+    memset(sqe, 0, sizeof(*sqe));
+    sqe->opcode = (s.req.op == BlockRequest::READ) ? IORING_OP_READV : IORING_OP_WRITEV;
+    sqe->fd = fd;
+    sqe->off = static_cast<std::uint64_t>(s.req.start_block) * BLOCK_SIZE + s.done;
+    sqe->addr = reinterpret_cast<std::uint64_t>(&iovecs[slot]);
+    sqe->len = 1;
+    sqe->user_data = slot;
+    sq_array[index] = index;
+    // 发布新的 tail，保证 SQE 内容先于 tail 对内核可见
+    __atomic_store_n(sq_tail, tail + 1, __ATOMIC_RELEASE);
+    return true;
+}
+
+void AsyncIOEngine::flushRing_()
+{
+    int busy_retries = 0;
+    while (true)
+    {
+        unsigned head = __atomic_load_n(sq_head, __ATOMIC_ACQUIRE);
+        unsigned tail = *sq_tail;
+        if (head == tail)
+            return;
+        int r = static_cast<int>(syscall(__NR_io_uring_enter, ring_fd, tail - head, 0, 0, nullptr, 0));
+        if (r > 0)
+            continue; // 内核可能只收下一部分，剩下的再交一次
+        if (r < 0 && errno == EINTR)
+            continue;
+        if (r < 0 && (errno == EAGAIN || errno == EBUSY) && busy_retries++ < 8)
+        {
+            reapRing_(false); // 完成队列满或内核资源暂缺：先回收一批再重试
+            continue;
+        }
+
+        // 硬错误 (或内核一个也不收)：撤回剩余 SQE，改走 pread/pwrite 同步完成，
+        // 这样 in_flight 里只剩真正交给内核的请求，drain 不会空等
+        head = __atomic_load_n(sq_head, __ATOMIC_ACQUIRE);
+        for (unsigned i = head; i != tail; ++i)
+        {
+            const io_uring_sqe *sqe = static_cast<io_uring_sqe *>(sqes_ptr) + sq_array[i & *sq_mask];
+            unsigned slot = static_cast<unsigned>(sqe->user_data);
+            Slot &s = slots[slot];
+            s.ok = finishSync_(s);
+            s.done_time = Clock::now();
+            complete_(slot);
+        }
+        // 未使用 SQPOLL，内核只在 io_uring_enter 内读取 SQ，此时回退 tail 是安全的
+        __atomic_store_n(sq_tail, head, __ATOMIC_RELEASE);
+        return;
+    }
+}
+
+int AsyncIOEngine::reapRing_(bool wait)
+{
+    if (wait && in_flight > 0)
+    {
+        while (*cq_head == __atomic_load_n(cq_tail, __ATOMIC_ACQUIRE))
+        {
+            int r = static_cast<int>(syscall(__NR_io_uring_enter, ring_fd, 0, 1, IORING_ENTER_GETEVENTS, nullptr, 0));
+            if (r < 0 && errno != EINTR && errno != EAGAIN)
+                break; // 硬错误：不在这里阻塞，交给调用者下一轮处理
+        }
+    }
+
+    int reaped = 0;
+    unsigned head = *cq_head;
+    unsigned tail = __atomic_load_n(cq_tail, __ATOMIC_ACQUIRE);
+    while (head != tail)
+    {
+        io_uring_cqe *cqe = static_cast<io_uring_cqe *>(cqes) + (head & *cq_mask);
+        unsigned slot = static_cast<unsigned>(cqe->user_data);
+        Slot &s = slots[slot];
+        std::size_t len = static_cast<std::size_t>(s.req.count) * BLOCK_SIZE;
+        if (cqe->res < 0)
+        {
+            s.ok = false;
+        }
+        else
+        {
+            s.done += static_cast<std::size_t>(cqe->res);
+            // 短读写：剩余部分同步补完
+            s.ok = (s.done >= len) || (cqe->res > 0 && finishSync_(s));
+        }
+        s.done_time = Clock::now();
+        ++head;
+        complete_(slot);
+        ++reaped;
+    }
+    __atomic_store_n(cq_head, head, __ATOMIC_RELEASE);
+    return reaped;
+}
+
+// ================= 线程池 =================
+
+void AsyncIOEngine::startWorkers_()
+{
+    unsigned n = std::min(queue_depth, static_cast<unsigned>(ASYNC_POOL_THREADS));
+    stopping = false;
+    for (unsigned i = 0; i < n; ++i)
+        workers.emplace_back(&AsyncIOEngine::workerLoop_, this);
+}
+
+void AsyncIOEngine::stopWorkers_()
+{
+    {
+        std::lock_guard<std::mutex> lock(mtx);
+        stopping = true;
+    }
+    work_cv.notify_all();
+    for (auto &t : workers)
+        t.join();
+    workers.clear();
+}
+
+void AsyncIOEngine::workerLoop_()
+{
+    while (true)
+    {
+        unsigned slot;
+        {
+            std::unique_lock<std::mutex> lock(mtx);
+            work_cv.wait(lock, [this]
+                         { return stopping || !pending.empty(); });
+            if (pending.empty())
+                return;
+            slot = pending.front();
+            pending.pop_front();
+        }
+
+        Slot &s = slots[slot];
+        s.ok = finishSync_(s);
+        s.done_time = Clock::now();
+
+        {
+            std::lock_guard<std::mutex> lock(mtx);
+            finished.push_back(slot);
+        }
+        done_cv.notify_one();
+    }
+}
+
+int AsyncIOEngine::reapPool_(bool wait)
+{
+    std::deque<unsigned> done;
+    {
+        std::unique_lock<std::mutex> lock(mtx);
+        if (wait && in_flight > 0)
+            done_cv.wait(lock, [this]
+                         { return !finished.empty(); });
+        done.swap(finished);
+    }
+    for (unsigned slot : done)
+        complete_(slot);
+    return static_cast<int>(done.size());
+}
+
+// ================= 公共部分 =================
+
+bool AsyncIOEngine::finishSync_(Slot &s)
+{
+    std::size_t len = static_cast<std::size_t>(s.req.count) * BLOCK_SIZE;
+    off_t pos = static_cast<off_t>(s.req.start_block) * BLOCK_SIZE;
+    while (s.done < len)
+    {
+        ssize_t n = (s.req.op == BlockRequest::READ)
+                        ? pread(fd, s.req.buf + s.done, len - s.done, pos + s.done)
+                        : pwrite(fd, s.req.buf + s.done, len - s.done, pos + s.done);
+        if (n <= 0)
+            return false;
+        s.done += static_cast<std::size_t>(n);
+    }
+    return true;
+}
+
+void AsyncIOEngine::complete_(unsigned slot)
+{
+    Slot &s = slots[slot];
+    auto us = std::chrono::duration_cast<std::chrono::microseconds>(s.done_time - s.submit_time).count();
+    std::uint64_t latency = us > 0 ? static_cast<std::uint64_t>(us) : 0;
+    stats_.total_latency_us += latency;
+    stats_.max_latency_us = std::max(stats_.max_latency_us, latency);
+    ++stats_.completed;
+    if (!s.ok)
+        ++stats_.failed;
+
+    if (s.req.callback)
+        s.req.callback(s.req, s.ok);
+    completions.push_back(BlockCompletion{s.req.user_data, s.ok});
+
+    s.busy = false;
+    s.req = BlockRequest{};
+    free_slots.push_back(slot);
+    --in_flight;
+}
+
+int AsyncIOEngine::submit(const std::vector<BlockRequest> &batch)
+{
+    ++stats_.batches;
+    int accepted = 0;
+
+    for (const auto &req : batch)
+    {
+        if (req.count <= 0 || req.start_block < 0 || req.start_block + req.count > DISK_BLOCKS || !req.buf)
+        {
+            // 非法请求直接以失败完成
+            if (req.callback)
+                req.callback(req, false);
+            completions.push_back(BlockCompletion{req.user_data, false});
+            ++stats_.failed;
+            continue;
+        }
+
+        // 队列已满：先把已排队的交给内核，再至少回收一个完成项
+        while (free_slots.empty())
+        {
+            if (usingIoUring())
+            {
+                flushRing_();
+                if (free_slots.empty())
+                    reapRing_(true);
+            }
+            else
+            {
+                reapPool_(true);
+            }
+        }
+
+        unsigned slot = free_slots.back();
+        free_slots.pop_back();
+        Slot &s = slots[slot];
+        s.req = req;
+        s.done = 0;
+        s.ok = false;
+        s.busy = true;
+        s.submit_time = Clock::now();
+        ++in_flight;
+        ++stats_.submitted;
+        ++accepted;
+
+        if (usingIoUring())
+        {
+            queueRing_(slot);
+        }
+        else
+        {
+            {
+                std::lock_guard<std::mutex> lock(mtx);
+                pending.push_back(slot);
+            }
+            work_cv.notify_one();
+        }
+    }
+
+    // 整批请求一次系统调用提交
+    if (usingIoUring())
+        flushRing_();
+    return accepted;
+}
+
+int AsyncIOEngine::poll(std::vector<BlockCompletion> *out, bool wait)
+{
+    if (completions.empty() || !wait)
+    {
+        if (usingIoUring())
+            reapRing_(wait && completions.empty());
+        else
+            reapPool_(wait && completions.empty());
+    }
+    int n = static_cast<int>(completions.size());
+    if (out)
+        out->insert(out->end(), completions.begin(), completions.end());
+    completions.clear();
+    return n;
+}
+
+void AsyncIOEngine::drain(std::vector<BlockCompletion> *out)
+{
+    while (in_flight > 0)
+    {
+        if (usingIoUring())
+            reapRing_(true);
+        else
+            reapPool_(true);
+    }
+    if (out)
+        out->insert(out->end(), completions.begin(), completions.end());
+    completions.clear();
+}
@@ -0,0 +1,204 @@
+#include "bitmap.h"
+#include <algorithm>
+#include <cstring>
+
+Bitmap::Bitmap(int bits, int chunk_bytes) : bits(0), chunk_bytes(chunk_bytes > 0 ? chunk_bytes : 1)
+{
+    resize(bits);
+}
+
+void Bitmap::resize(int n)
+{
+    bits = n < 0 ? 0 : n;
+    words.assign((static_cast<std::size_t>(bits) + 63) / 64, 0);
+    dirty.assign((byteSize() + chunk_bytes - 1) / chunk_bytes, 0);
+    cursor = 0;
+}
+
+void Bitmap::clearAll()
+{
+    std::fill(words.begin(), words.end(), 0);
+    markAllDirty();
+    cursor = 0;
+}
+
+void Bitmap::setRange(int first, int count)
+{
+    int end = std::min(bits, first + count);
+    for (int i = std::max(0, first); i < end;)
+    {
+        // 整字对齐时一次置满 64 位
+        if ((i & 63) == 0 && i + 64 <= end)
+        {
+            words[i >> 6] = ~std::uint64_t(0);
+            dirty[chunkOf_(i)] = 1;
+            i += 64;
+        }
+        else
+        {
+            set(i);
+            ++i;
+        }
+    }
+}
+
+int Bitmap::count() const
+{
+    int n = 0;
+    for (std::uint64_t w : words)
+        n += __builtin_popcountll(w);
+    return n;
+}
+
+int Bitmap::findZero(int lo, int hi) const
+{
+    lo = std::max(lo, 0);
+    hi = std::min(hi, bits);
+    if (lo >= hi)
+        return -1;
+
+    int w = lo >> 6;
+    int last_w = (hi - 1) >> 6;
+    // 第一个字屏蔽掉 lo 之前的位 (视为已占用)
+    std::uint64_t free_bits = ~words[w] & (~std::uint64_t(0) << (lo & 63));
+    while (true)
+    {
+        if (free_bits)
+        {
+            int i = (w << 6) + __builtin_ctzll(free_bits);
+            return i < hi ? i : -1;
+        }
+        if (++w > last_w)
+            return -1;
+        free_bits = ~words[w];
+    }
+}
+
+int Bitmap::findOne(int lo, int hi) const
+{
+    lo = std::max(lo, 0);
+    hi = std::min(hi, bits);
+    if (lo >= hi)
+        return hi;
+
+    int w = lo >> 6;
+    int last_w = (hi - 1) >> 6;
+    std::uint64_t used_bits = words[w] & (~std::uint64_t(0) << (lo & 63));
+    while (true)
+    {
+        if (used_bits)
+        {
+            int i = (w << 6) + __builtin_ctzll(used_bits);
+            return i < hi ? i : hi;
+        }
+        if (++w > last_w)
+            return hi;
+        used_bits = words[w];
+    }
+}
+
+int Bitmap::allocateRun(int lo, int hi, int goal, int want, int *got)
+{
+    *got = 0;
+    lo = std::max(lo, 0);
+    hi = std::min(hi, bits);
+    if (want <= 0 || lo >= hi)
+        return -1;
+
+    int start = -1;
+    int len = 0;
+    if (goal >= lo && goal < hi && !test(goal))
+    {
+        // 紧接在文件上一块之后：尽量延伸，保持文件连续
+        start = goal;
+        len = findOne(goal, std::min(hi, goal + want)) - goal;
+    }
+    else
+    {
+        int from = (cursor >= lo && cursor < hi) ? cursor : lo;
+        int ranges[2][2] = {{from, hi}, {lo, from}};
+        for (int r = 0; r < 2 && len < want; ++r)
+        {
+            int a = ranges[r][0];
+            int b = ranges[r][1];
+            int p = findZero(a, b);
+            while (p >= 0)
+            {
+                int end = findOne(p, std::min(b, p + want));
+                if (end - p > len)
+                {
+                    start = p;
+                    len = end - p;
+                    if (len >= want)
+                        break;
+                }
+                p = findZero(end, b);
+            }
+        }
+    }
+    if (start < 0 || len <= 0)
+        return -1;
+
+    setRange(start, len);
+    cursor = start + len;
+    *got = len;
+    return start;
+}
+
+int Bitmap::allocate(int lo, int hi)
+{
+    int start = (cursor >= lo && cursor < hi) ? cursor : lo;
+    int i = findZero(start, hi);
+    if (i < 0 && start > lo)
+        i = findZero(lo, start); // 回绕
+    if (i < 0)
+        return -1;
+    set(i);
+    cursor = i + 1;
+    return i;
+}
+
+bool Bitmap::anyDirty() const
+{
+    return std::find(dirty.begin(), dirty.end(), 1) != dirty.end();
+}
+
+void Bitmap::markAllDirty()
+{
+    std::fill(dirty.begin(), dirty.end(), 1);
+}
+
+void Bitmap::clearDirty()
+{
+    std::fill(dirty.begin(), dirty.end(), 0);
+}
+
+void Bitmap::chunkToBytes(int c, char *out) const
+{
+    memset(out, 0, chunk_bytes);
+    std::size_t first = static_cast<std::size_t>(c) * chunk_bytes;
+    std::size_t last = std::min(first + chunk_bytes, byteSize());
+    for (std::size_t k = first; k < last; ++k)
+        out[k - first] = static_cast<char>((words[k >> 3] >> ((k & 7) * 8)) & 0xff);
+}
+
+void Bitmap::toBytes(char *out, std::size_t len) const
+{
+    memset(out, 0, len);
+    std::size_t n = std::min(len, byteSize());
+    for (std::size_t k = 0; k < n; ++k)
+        out[k] = static_cast<char>((words[k >> 3] >> ((k & 7) * 8)) & 0xff);
+}
+
+void Bitmap::fromBytes(const char *in, std::size_t len)
+{
+    std::fill(words.begin(), words.end(), 0);
+    std::size_t n = std::min(len, byteSize());
+    for (std::size_t k = 0; k < n; ++k)
+        words[k >> 3] |= std::uint64_t(static_cast<unsigned char>(in[k])) << ((k & 7) * 8);
+    // 清掉超出 bits 的尾部位
+    if (bits & 63)
+        words.back() &= (std::uint64_t(1) << (bits & 63)) - 1;
+    clearDirty();
+    cursor = 0;
+}
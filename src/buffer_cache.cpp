@@ -0,0 +1,351 @@
+#include "buffer_cache.h"
+#include <cstring>
+#include <algorithm>
+
+BufferCache::BufferCache(DiskManager &disk, std::size_t capacity)
+    : disk(disk), capacity_(capacity == 0 ? 1 : capacity)
+{
+}
+
+BufferCache::~BufferCache()
+{
+    flush();
+}
+
+BufferCache::Buffer *BufferCache::lookup_(int block_id)
+{
+    auto it = index_.find(block_id);
+    if (it == index_.end())
+        return nullptr;
+    // 移到 LRU 头部 (splice 不会使迭代器失效)
+    lru_.splice(lru_.begin(), lru_, it->second);
+    return &*it->second;
+}
+
+BufferCache::Buffer *BufferCache::insert_(int block_id)
+{
+    while (lru_.size() >= capacity_)
+    {
+        if (!evictOne_())
+            break;
+    }
+    lru_.emplace_front();
+    Buffer &b = lru_.front();
+    b.block_id = block_id;
+    b.dirty = false;
+    index_[block_id] = lru_.begin();
+    return &b;
+}
+
+bool BufferCache::evictOne_()
+{
+    auto it = lru_.end();
+    while (it != lru_.begin())
+    {
+        --it;
+        if (it->pins > 0)
+            continue; // 被读视图引用，跳过
+        if (it->dirty && !writeBack_(*it))
+            return false; // 写回失败时保留该块，避免丢数据
+        index_.erase(it->block_id);
+        lru_.erase(it);
+        ++stats_.evictions;
+        return true;
+    }
+    return false; // 全部被钉住，暂时超出容量
+}
+
+bool BufferCache::writeBack_(Buffer &b)
+{
+    if (!disk.writeBlock(b.block_id, b.data))
+        return false;
+    b.dirty = false;
+    ++stats_.writebacks;
+    return true;
+}
+
+bool BufferCache::readBlock(int block_id, char *buf)
+{
+    if (block_id < 0 || block_id >= DISK_BLOCKS)
+        return false;
+
+    Buffer *b = lookup_(block_id);
+    if (b)
+    {
+        ++stats_.hits;
+        memcpy(buf, b->data, BLOCK_SIZE);
+        return true;
+    }
+
+    ++stats_.misses;
+    b = insert_(block_id);
+    if (!disk.readBlock(block_id, b->data))
+    {
+        index_.erase(block_id);
+        lru_.pop_front();
+        return false;
+    }
+    memcpy(buf, b->data, BLOCK_SIZE);
+    return true;
+}
+
+bool BufferCache::writeBlock(int block_id, const char *buf)
+{
+    if (block_id < 0 || block_id >= DISK_BLOCKS)
+        return false;
+
+    // 整块写入，未命中时无需先读盘
+    Buffer *b = lookup_(block_id);
+    if (!b)
+        b = insert_(block_id);
+    memcpy(b->data, buf, BLOCK_SIZE);
+    b->dirty = true;
+    return true;
+}
+
+void BufferCache::prefetch(const std::vector<int> &block_ids)
+{
+    std::vector<int> miss_ids;
+    for (int block_id : block_ids)
+    {
+        if (block_id < 0 || block_id >= DISK_BLOCKS || index_.count(block_id) || disk.mappedBlock(block_id))
+            continue;
+        miss_ids.push_back(block_id);
+    }
+    if (miss_ids.empty())
+        return;
+
+    std::vector<char> tmp(miss_ids.size() * BLOCK_SIZE);
+    std::vector<bool> ok;
+    disk.readBlocks(miss_ids, tmp.data(), &ok);
+    for (std::size_t k = 0; k < miss_ids.size(); ++k)
+    {
+        if (ok[k] && !index_.count(miss_ids[k]))
+        {
+            ++stats_.misses;
+            memcpy(insert_(miss_ids[k])->data, tmp.data() + k * BLOCK_SIZE, BLOCK_SIZE);
+        }
+    }
+}
+
+const char *BufferCache::pinBlock(int block_id, bool *pinned)
+{
+    *pinned = false;
+    if (block_id < 0 || block_id >= DISK_BLOCKS)
+        return nullptr;
+
+    Buffer *b = lookup_(block_id);
+    if (b)
+    {
+        ++stats_.hits;
+    }
+    else
+    {
+        // 缓存中没有更新的版本，MMAP 后端的映射区就是最新内容
+        if (const char *mapped = disk.mappedBlock(block_id))
+            return mapped;
+        ++stats_.misses;
+        b = insert_(block_id);
+        if (!disk.readBlock(block_id, b->data))
+        {
+            index_.erase(block_id);
+            lru_.pop_front();
+            return nullptr;
+        }
+    }
+    ++b->pins;
+    *pinned = true;
+    return b->data;
+}
+
+void BufferCache::unpinBlock(int block_id)
+{
+    auto it = index_.find(block_id);
+    if (it != index_.end() && it->second->pins > 0)
+        --it->second->pins;
+}
+
+void BufferCache::discard(int block_id)
+{
+    auto it = index_.find(block_id);
+    if (it == index_.end())
+        return;
+    if (it->second->pins > 0)
+    {
+        it->second->dirty = false;
+        return;
+    }
+    lru_.erase(it->second);
+    index_.erase(it);
+}
+
+void BufferCache::installZeroBlock(int block_id, bool dirty)
+{
+    if (block_id < 0 || block_id >= DISK_BLOCKS)
+        return;
+    Buffer *b = lookup_(block_id);
+    if (!b)
+        b = insert_(block_id);
+    memset(b->data, 0, BLOCK_SIZE);
+    b->dirty = b->dirty || dirty;
+}
+
+int BufferCache::readBlocks(const std::vector<int> &block_ids, char *buf, std::vector<bool> *status)
+{
+    const int n = static_cast<int>(block_ids.size());
+    if (status)
+        status->assign(n, false);
+
+    // 先处理命中的块，记录未命中的位置
+    std::vector<int> miss_ids;
+    std::vector<int> miss_pos;
+    int ok_count = 0;
+    for (int i = 0; i < n; ++i)
+    {
+        int block_id = block_ids[i];
+        if (block_id < 0 || block_id >= DISK_BLOCKS)
+            continue;
+        Buffer *b = lookup_(block_id);
+        if (b)
+        {
+            ++stats_.hits;
+            memcpy(buf + static_cast<std::size_t>(i) * BLOCK_SIZE, b->data, BLOCK_SIZE);
+            if (status)
+                (*status)[i] = true;
+            ++ok_count;
+        }
+        else
+        {
+            ++stats_.misses;
+            miss_ids.push_back(block_id);
+            miss_pos.push_back(i);
+        }
+    }
+    if (miss_ids.empty())
+        return ok_count;
+
+    // 未命中的块一次性交给磁盘层，连续块会被合并
+    std::vector<char> tmp(miss_ids.size() * BLOCK_SIZE);
+    std::vector<bool> miss_ok;
+    disk.readBlocks(miss_ids, tmp.data(), &miss_ok);
+    for (std::size_t k = 0; k < miss_ids.size(); ++k)
+    {
+        if (!miss_ok[k])
+            continue;
+        const char *src = tmp.data() + k * BLOCK_SIZE;
+        memcpy(buf + static_cast<std::size_t>(miss_pos[k]) * BLOCK_SIZE, src, BLOCK_SIZE);
+        // 同一批中可能重复出现同一块，已在缓存中则不重复插入
+        if (!lookup_(miss_ids[k]))
+            memcpy(insert_(miss_ids[k])->data, src, BLOCK_SIZE);
+        if (status)
+            (*status)[miss_pos[k]] = true;
+        ++ok_count;
+    }
+    return ok_count;
+}
+
+int BufferCache::writeBlocks(const std::vector<int> &block_ids, const char *buf, std::vector<bool> *status)
+{
+    const int n = static_cast<int>(block_ids.size());
+    if (status)
+        status->assign(n, false);
+    int ok_count = 0;
+    for (int i = 0; i < n; ++i)
+    {
+        if (writeBlock(block_ids[i], buf + static_cast<std::size_t>(i) * BLOCK_SIZE))
+        {
+            if (status)
+                (*status)[i] = true;
+            ++ok_count;
+        }
+    }
+    return ok_count;
+}
+
+int BufferCache::writeBlocksThrough(const std::vector<int> &block_ids, const char *buf)
+{
+    std::vector<bool> written;
+    disk.writeBlocks(block_ids, buf, &written);
+    int ok_count = 0;
+    for (std::size_t i = 0; i < block_ids.size(); ++i)
+    {
+        const char *src = buf + i * BLOCK_SIZE;
+        if (!written[i])
+        {
+            ok_count += writeBlock(block_ids[i], src) ? 1 : 0;
+            continue;
+        }
+        auto it = index_.find(block_ids[i]);
+        if (it != index_.end())
+        {
+            memcpy(it->second->data, src, BLOCK_SIZE);
+            it->second->dirty = false;
+        }
+        ++ok_count;
+    }
+    return ok_count;
+}
+
+bool BufferCache::writeBackBlock(int block_id)
+{
+    auto it = index_.find(block_id);
+    if (it == index_.end() || !it->second->dirty)
+        return true;
+    return writeBack_(*it->second);
+}
+
+bool BufferCache::flush(bool skip_pinned)
+{
+    std::vector<Buffer *> dirty;
+    for (auto &b : lru_)
+    {
+        if (b.dirty && !(skip_pinned && b.pins > 0))
+            dirty.push_back(&b);
+    }
+    if (dirty.empty())
+        return true;
+
+    // 按块号排序，让相邻的脏块在磁盘层合并成一次写
+    std::sort(dirty.begin(), dirty.end(), [](const Buffer *a, const Buffer *b)
+              { return a->block_id < b->block_id; });
+    std::vector<int> ids;
+    std::vector<char> tmp(dirty.size() * BLOCK_SIZE);
+    for (std::size_t k = 0; k < dirty.size(); ++k)
+    {
+        ids.push_back(dirty[k]->block_id);
+        memcpy(tmp.data() + k * BLOCK_SIZE, dirty[k]->data, BLOCK_SIZE);
+    }
+
+    std::vector<bool> written;
+    disk.writeBlocks(ids, tmp.data(), &written);
+    bool ok = true;
+    for (std::size_t k = 0; k < dirty.size(); ++k)
+    {
+        if (written[k])
+        {
+            dirty[k]->dirty = false;
+            ++stats_.writebacks;
+        }
+        else
+        {
+            ok = false;
+        }
+    }
+    return ok;
+}
+
+void BufferCache::invalidate()
+{
+    lru_.clear();
+    index_.clear();
+}
+
+void BufferCache::setCapacity(std::size_t capacity)
+{
+    capacity_ = (capacity == 0) ? 1 : capacity;
+    while (lru_.size() > capacity_)
+    {
+        if (!evictOne_())
+            break;
+    }
+}
@@ -1,11 +1,28 @@
 #include "disk_manager.h"
 #include <iostream>
 #include <cstring>
+#include <algorithm>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
 
-DiskManager::DiskManager()
+DiskManager::DiskManager(DiskBackend backend) : backend(backend)
 {
     if (diskExists())
     {
+        if (!openFd_())
+        {
+            std::cerr << "Error: Could not open existing disk file." << std::endl;
+            return;
+        }
+        if (backend == DiskBackend::MMAP)
+        {
+            if (openMapping_())
+                return;
+            std::cerr << "Warning: Could not map existing disk file, falling back to stream I/O." << std::endl;
+            fallBackToStream_();
+        }
         disk_file.open(DISK_PATH, std::ios::in | std::ios::out | std::ios::binary);
         if (!disk_file.is_open())
         {
@@ -16,6 +33,7 @@ DiskManager::DiskManager()
 
 DiskManager::~DiskManager()
 {
+    closeFd_();
     if (disk_file.is_open())
     {
         disk_file.close();
@@ -28,28 +46,118 @@ bool DiskManager::diskExists()
     return f.good();
 }
 
+bool DiskManager::isOpen_() const
+{
+    return backend == DiskBackend::MMAP ? disk_map != nullptr : disk_file.is_open();
+}
+
+bool DiskManager::openFd_()
+{
+    closeFd_();
+    disk_fd = open(DISK_PATH.c_str(), O_RDWR);
+    if (disk_fd < 0)
+        return false;
+    if (backend == DiskBackend::STREAM && async_depth > 0)
+        engine.reset(new AsyncIOEngine(disk_fd, async_depth));
+    return true;
+}
+
+void DiskManager::setAsyncQueueDepth(unsigned depth)
+{
+    async_depth = std::min(depth, ASYNC_MAX_QUEUE_DEPTH);
+    engine.reset(); // 析构时会等待在途请求完成
+    if (backend == DiskBackend::STREAM && disk_fd >= 0 && async_depth > 0)
+        engine.reset(new AsyncIOEngine(disk_fd, async_depth));
+}
+
+bool DiskManager::openMapping_()
+{
+    map_size = static_cast<std::size_t>(DISK_BLOCKS) * BLOCK_SIZE;
+    // 映射超出文件末尾的部分一访问就是 SIGBUS：镜像偏短 (被截断) 时先补足长度，新增部分读出为 0
+    struct stat st;
+    if (fstat(disk_fd, &st) != 0)
+    {
+        map_size = 0;
+        return false;
+    }
+    if (static_cast<std::size_t>(st.st_size) < map_size)
+    {
+        std::cerr << "Warning: disk file is shorter than " << map_size << " bytes, extending it." << std::endl;
+        if (ftruncate(disk_fd, static_cast<off_t>(map_size)) != 0)
+        {
+            map_size = 0;
+            return false;
+        }
+    }
+    void *p = mmap(nullptr, map_size, PROT_READ | PROT_WRITE, MAP_SHARED, disk_fd, 0);
+    if (p == MAP_FAILED)
+    {
+        map_size = 0;
+        return false;
+    }
+    disk_map = static_cast<char *>(p);
+    return true;
+}
+
+void DiskManager::fallBackToStream_()
+{
+    backend = DiskBackend::STREAM;
+    if (disk_fd >= 0 && async_depth > 0)
+        engine.reset(new AsyncIOEngine(disk_fd, async_depth));
+}
+
+void DiskManager::closeFd_()
+{
+    engine.reset();
+    if (disk_map)
+    {
+        msync(disk_map, map_size, MS_SYNC);
+        munmap(disk_map, map_size);
+        disk_map = nullptr;
+        map_size = 0;
+    }
+    if (disk_fd >= 0)
+    {
+        close(disk_fd);
+        disk_fd = -1;
+    }
+}
+
 void DiskManager::createDisk()
 {
+    closeFd_();
     if (disk_file.is_open())
     {
         disk_file.close();
     }
-    disk_file.open(DISK_PATH, std::ios::out | std::ios::binary | std::ios::trunc);
-    if (!disk_file.is_open())
+
+    // 稀疏文件：只设置文件长度而不逐块写 0，未写过的区域读出来就是 0
+    int fd = open(DISK_PATH.c_str(), O_RDWR | O_CREAT | O_TRUNC, 0644);
+    if (fd < 0)
     {
         std::cerr << "Error: Could not create disk file." << std::endl;
         return;
     }
-
-    char *buffer = new char[BLOCK_SIZE];
-    memset(buffer, 0, BLOCK_SIZE);
-    for (int i = 0; i < DISK_BLOCKS; ++i)
+    bool sized = ftruncate(fd, static_cast<off_t>(DISK_BLOCKS) * BLOCK_SIZE) == 0;
+    close(fd);
+    if (!sized)
     {
-        disk_file.write(buffer, BLOCK_SIZE);
+        std::cerr << "Error: Could not size disk file." << std::endl;
+        return;
     }
-    delete[] buffer;
 
-    disk_file.close();
+    if (!openFd_())
+    {
+        std::cerr << "Error: Could not reopen disk file after creation." << std::endl;
+        return;
+    }
+    if (backend == DiskBackend::MMAP)
+    {
+        if (openMapping_())
+            return;
+        std::cerr << "Warning: Could not map disk file after creation, falling back to stream I/O." << std::endl;
+        fallBackToStream_();
+    }
     // Reopen in r/w mode
     disk_file.open(DISK_PATH, std::ios::in | std::ios::out | std::ios::binary);
     if (!disk_file.is_open())
@@ -60,10 +168,15 @@ void DiskManager::createDisk()
 
 bool DiskManager::readBlock(int block_id, char *buf)
 {
-    if (!disk_file.is_open() || block_id < 0 || block_id >= DISK_BLOCKS)
+    if (!isOpen_() || block_id < 0 || block_id >= DISK_BLOCKS)
     {
         return false;
     }
+    if (backend == DiskBackend::MMAP)
+    {
+        memcpy(buf, disk_map + static_cast<std::size_t>(block_id) * BLOCK_SIZE, BLOCK_SIZE);
+        return true;
+    }
     disk_file.seekg(block_id * BLOCK_SIZE, std::ios::beg);
     disk_file.read(buf, BLOCK_SIZE);
     return disk_file.good();
@@ -71,11 +184,209 @@ bool DiskManager::readBlock(int block_id, char *buf)
 
 bool DiskManager::writeBlock(int block_id, const char *buf)
 {
-    if (!disk_file.is_open() || block_id < 0 || block_id >= DISK_BLOCKS)
+    if (!isOpen_() || block_id < 0 || block_id >= DISK_BLOCKS)
     {
         return false;
     }
+    if (backend == DiskBackend::MMAP)
+    {
+        memcpy(disk_map + static_cast<std::size_t>(block_id) * BLOCK_SIZE, buf, BLOCK_SIZE);
+        return true;
+    }
     disk_file.seekp(block_id * BLOCK_SIZE, std::ios::beg);
     disk_file.write(buf, BLOCK_SIZE);
     return disk_file.good();
 }
+
+bool DiskManager::readRun_(int start_block, int count, char *buf)
+{
+    std::size_t len = static_cast<std::size_t>(count) * BLOCK_SIZE;
+    off_t pos = static_cast<off_t>(start_block) * BLOCK_SIZE;
+    if (backend == DiskBackend::MMAP)
+    {
+        memcpy(buf, disk_map + pos, len);
+        return true;
+    }
+    std::size_t done = 0;
+    while (done < len)
+    {
+        ssize_t n = pread(disk_fd, buf + done, len - done, pos + done);
+        if (n <= 0)
+            return false;
+        done += static_cast<std::size_t>(n);
+    }
+    return true;
+}
+
+bool DiskManager::writeRun_(int start_block, int count, const char *buf)
+{
+    std::size_t len = static_cast<std::size_t>(count) * BLOCK_SIZE;
+    off_t pos = static_cast<off_t>(start_block) * BLOCK_SIZE;
+    if (backend == DiskBackend::MMAP)
+    {
+        memcpy(disk_map + pos, buf, len);
+        return true;
+    }
+    std::size_t done = 0;
+    while (done < len)
+    {
+        ssize_t n = pwrite(disk_fd, buf + done, len - done, pos + done);
+        if (n <= 0)
+            return false;
+        done += static_cast<std::size_t>(n);
+    }
+    return true;
+}
+
+int DiskManager::transferRuns_(BlockRequest::Op op, const std::vector<int> &block_ids, char *buf, std::vector<bool> *status)
+{
+    const int n = static_cast<int>(block_ids.size());
+    if (status)
+        status->assign(n, false);
+    if (!isOpen_() || disk_fd < 0)
+        return 0;
+    // 流缓冲中可能还有未写出的数据，先刷到文件再走 pread/pwrite
+    if (disk_file.is_open())
+        disk_file.flush();
+
+    // 切分连续块号区间 [first, second)
+    std::vector<std::pair<int, int>> runs;
+    int i = 0;
+    while (i < n)
+    {
+        int j = i + 1;
+        while (j < n && block_ids[j] == block_ids[j - 1] + 1)
+            ++j;
+        runs.emplace_back(i, j);
+        i = j;
+    }
+
+    std::vector<bool> run_ok(runs.size(), false);
+    if (engine && runs.size() > 1)
+    {
+        // 多段同时提交，一次等待全部完成
+        std::vector<BlockRequest> batch;
+        for (std::size_t r = 0; r < runs.size(); ++r)
+        {
+            BlockRequest req;
+            req.op = op;
+            req.start_block = block_ids[runs[r].first];
+            req.count = runs[r].second - runs[r].first;
+            req.buf = buf + static_cast<std::size_t>(runs[r].first) * BLOCK_SIZE;
+            req.user_data = r;
+            batch.push_back(req);
+        }
+        std::vector<BlockCompletion> done;
+        engine->submit(batch);
+        engine->drain(&done);
+        for (const auto &c : done)
+            run_ok[c.user_data] = c.ok;
+    }
+    else
+    {
+        for (std::size_t r = 0; r < runs.size(); ++r)
+        {
+            int start = block_ids[runs[r].first];
+            int count = runs[r].second - runs[r].first;
+            if (start < 0 || start + count > DISK_BLOCKS)
+                continue;
+            char *p = buf + static_cast<std::size_t>(runs[r].first) * BLOCK_SIZE;
+            run_ok[r] = (op == BlockRequest::READ) ? readRun_(start, count, p) : writeRun_(start, count, p);
+        }
+    }
+
+    int ok_count = 0;
+    for (std::size_t r = 0; r < runs.size(); ++r)
+    {
+        if (!run_ok[r])
+            continue;
+        ok_count += runs[r].second - runs[r].first;
+        if (status)
+            std::fill(status->begin() + runs[r].first, status->begin() + runs[r].second, true);
+    }
+    return ok_count;
+}
+
+int DiskManager::readBlocks(const std::vector<int> &block_ids, char *buf, std::vector<bool> *status)
+{
+    return transferRuns_(BlockRequest::READ, block_ids, buf, status);
+}
+
+int DiskManager::writeBlocks(const std::vector<int> &block_ids, const char *buf, std::vector<bool> *status)
+{
+    // 写请求不会修改 buf，引擎接口统一使用 char *
+    return transferRuns_(BlockRequest::WRITE, block_ids, const_cast<char *>(buf), status);
+}
+
+bool DiskManager::readBlocks(int start_block, int count, char *buf)
+{
+    if (!isOpen_() || disk_fd < 0 || count < 0 || start_block < 0 || start_block + count > DISK_BLOCKS)
+        return false;
+    if (disk_file.is_open())
+        disk_file.flush();
+    return count == 0 || readRun_(start_block, count, buf);
+}
+
+bool DiskManager::writeBlocks(int start_block, int count, const char *buf)
+{
+    if (!isOpen_() || disk_fd < 0 || count < 0 || start_block < 0 || start_block + count > DISK_BLOCKS)
+        return false;
+    if (disk_file.is_open())
+        disk_file.flush();
+    return count == 0 || writeRun_(start_block, count, buf);
+}
+
+int DiskManager::discardBlocks(const std::vector<int> &block_ids)
+{
+    if (!isOpen_() || disk_fd < 0)
+        return 0;
+    if (disk_file.is_open())
+        disk_file.flush();
+
+    const int n = static_cast<int>(block_ids.size());
+    int ok_count = 0;
+    int i = 0;
+    while (i < n)
+    {
+        int j = i + 1;
+        while (j < n && block_ids[j] == block_ids[j - 1] + 1)
+            ++j;
+        int start = block_ids[i];
+        int count = j - i;
+        i = j;
+        if (start < 0 || start + count > DISK_BLOCKS)
+            continue;
+
+        // 打洞后该区域读出为 0 (对 MAP_SHARED 映射同样可见)，文件长度不变
+        if (fallocate(disk_fd, FALLOC_FL_PUNCH_HOLE | FALLOC_FL_KEEP_SIZE,
+                      static_cast<off_t>(start) * BLOCK_SIZE, static_cast<off_t>(count) * BLOCK_SIZE) == 0)
+        {
+            ok_count += count;
+            continue;
+        }
+        std::vector<char> zeros(static_cast<std::size_t>(count) * BLOCK_SIZE, 0);
+        if (writeRun_(start, count, zeros.data()))
+            ok_count += count;
+    }
+    return ok_count;
+}
+
+bool DiskManager::flush()
+{
+    if (!isOpen_())
+        return false;
+    if (backend == DiskBackend::MMAP)
+        return msync(disk_map, map_size, MS_SYNC) == 0;
+    disk_file.flush();
+    // 流缓冲只是交给了内核，还要 fdatasync 才真正落到存储上 (镜像长度固定，不必同步文件元数据)
+    if (disk_fd >= 0 && fdatasync(disk_fd) != 0)
+        return false;
+    return disk_file.good();
+}
+
+const char *DiskManager::mappedBlock(int block_id) const
+{
+    if (!disk_map || block_id < 0 || block_id >= DISK_BLOCKS)
+        return nullptr;
+    return disk_map + static_cast<std::size_t>(block_id) * BLOCK_SIZE;
+}
@@ -4,9 +4,208 @@
 #include <algorithm>
 #include <vector>
 #include <sstream>
+#include <map>
+#include <cstdlib>
+#include <climits>
+
+// 空洞的只读视图指向这个全 0 块
+static const char ZERO_BLOCK[BLOCK_SIZE] = {};
+
+// ---- 变长目录项在一个目录块 / 内联目录区内的操作 (buf 为区域起始，len 为区域长度) ----
+
+// 整个区域初始化为一条空记录
+static void dir_init_unit(char *buf, int len)
+{
+    memset(buf, 0, len);
+    DirEntry *e = reinterpret_cast<DirEntry *>(buf);
+    e->d_inode_id = -1;
+    e->d_rec_len = static_cast<uint16_t>(len);
+}
+
+// 记录头是否完整且没有越出区域 (防止损坏的记录链导致死循环或越界)
+static bool dir_entry_valid(const DirEntry *e, int off, int len)
+{
+    return e->d_rec_len >= DIR_ENTRY_HEADER && (e->d_rec_len & 3) == 0 && off + e->d_rec_len <= len;
+}
+
+// 遍历区域内的有效记录，fn 返回 true 时停止并返回 true
+static bool dir_scan_unit(const char *buf, int len, const std::function<bool(const DirEntry &, const char *)> &fn)
+{
+    for (int off = 0; off + DIR_ENTRY_HEADER <= len;)
+    {
+        const DirEntry *e = reinterpret_cast<const DirEntry *>(buf + off);
+        if (!dir_entry_valid(e, off, len))
+            break;
+        if (e->d_inode_id >= 0 && e->d_name_len > 0 && fn(*e, buf + off + DIR_ENTRY_HEADER))
+            return true;
+        off += e->d_rec_len;
+    }
+    return false;
+}
+
+// 在区域内找到足够的空闲空间 (空记录或记录尾部) 插入新记录
+static bool dir_insert_unit(char *buf, int len, int inode_id, const std::string &name, int type)
+{
+    int need = dirRecLen(static_cast<int>(name.size()));
+    for (int off = 0; off + DIR_ENTRY_HEADER <= len;)
+    {
+        DirEntry *e = reinterpret_cast<DirEntry *>(buf + off);
+        if (!dir_entry_valid(e, off, len))
+            return false;
+        int used = e->d_inode_id >= 0 ? dirRecLen(e->d_name_len) : 0;
+        if (e->d_rec_len - used >= need)
+        {
+            DirEntry *n = e;
+            if (used > 0)
+            {
+                // 从当前记录的尾部切出新记录
+                n = reinterpret_cast<DirEntry *>(buf + off + used);
+                n->d_rec_len = static_cast<uint16_t>(e->d_rec_len - used);
+                e->d_rec_len = static_cast<uint16_t>(used);
+            }
+            n->d_inode_id = inode_id;
+            n->d_name_len = static_cast<uint8_t>(name.size());
+            n->d_type = static_cast<uint8_t>(type);
+            memcpy(reinterpret_cast<char *>(n) + DIR_ENTRY_HEADER, name.data(), name.size());
+            return true;
+        }
+        off += e->d_rec_len;
+    }
+    return false;
+}
+
+// 删除名为 name 的记录：空间并入前一条记录，区域内的第一条记录只标记为空
+static bool dir_remove_unit(char *buf, int len, const std::string &name)
+{
+    DirEntry *prev = nullptr;
+    for (int off = 0; off + DIR_ENTRY_HEADER <= len;)
+    {
+        DirEntry *e = reinterpret_cast<DirEntry *>(buf + off);
+        if (!dir_entry_valid(e, off, len))
+            return false;
+        if (e->d_inode_id >= 0 && e->d_name_len == name.size() &&
+            memcmp(buf + off + DIR_ENTRY_HEADER, name.data(), name.size()) == 0)
+        {
+            if (prev)
+                prev->d_rec_len = static_cast<uint16_t>(prev->d_rec_len + e->d_rec_len);
+            else
+                e->d_inode_id = -1;
+            return true;
+        }
+        prev = e;
+        off += e->d_rec_len;
+    }
+    return false;
+}
+
+// ---- 哈希目录索引 ----
+
+// 第 0 块中 "." 和 ".." 之后的空记录，索引根紧跟在它的记录头后面
+static const int DX_FAKE_OFFSET = 2 * dirRecLen(2);
+static const int DX_ROOT_OFFSET = DX_FAKE_OFFSET + DIR_ENTRY_HEADER;
+static const int DX_LIMIT = static_cast<int>((BLOCK_SIZE - DX_ROOT_OFFSET - sizeof(DirIndexRoot)) / sizeof(DirIndexEntry));
+
+// 文件名哈希 (FNV-1a)
+static uint32_t dir_name_hash(const char *name, std::size_t len)
+{
+    uint32_t h = 2166136261u;
+    for (std::size_t i = 0; i < len; ++i)
+    {
+        h ^= static_cast<unsigned char>(name[i]);
+        h *= 16777619u;
+    }
+    return h;
+}
+
+static DirIndexRoot *dx_root(char *buf)
+{
+    return reinterpret_cast<DirIndexRoot *>(buf + DX_ROOT_OFFSET);
+}
+
+static DirIndexEntry *dx_entries(char *buf)
+{
+    return reinterpret_cast<DirIndexEntry *>(buf + DX_ROOT_OFFSET + sizeof(DirIndexRoot));
+}
+
+// 最后一个 dx_hash <= hash 的索引项 (第 0 项的 dx_hash 为 0，一定存在)
+static int dx_find_slot(const DirIndexEntry *entries, int count, uint32_t hash)
+{
+    int lo = 1;
+    int hi = count - 1;
+    int slot = 0;
+    while (lo <= hi)
+    {
+        int mid = (lo + hi) / 2;
+        if (entries[mid].dx_hash <= hash)
+        {
+            slot = mid;
+            lo = mid + 1;
+        }
+        else
+        {
+            hi = mid - 1;
+        }
+    }
+    return slot;
+}
+
+// 分裂 / 重建叶子时在内存中暂存的目录项
+struct DirRecord
+{
+    uint32_t hash;
+    int inode_id;
+    int type;
+    std::string name;
+};
+
+static void dir_collect_unit(const char *buf, int len, std::vector<DirRecord> &out)
+{
+    dir_scan_unit(buf, len, [&out](const DirEntry &entry, const char *entry_name)
+    {
+        std::string name(entry_name, entry.d_name_len);
+        out.push_back({dir_name_hash(name.data(), name.size()), entry.d_inode_id, entry.d_type, name});
+        return false;
+    });
+}
+
+// 按哈希排好序的目录项一分为二：分界点两侧哈希不同 (同一哈希的目录项必须在同一叶子)，
+// 两侧都放得进一个块，且尽量各占一半；找不到返回 false
+static bool dir_split_records(const std::vector<DirRecord> &recs, std::size_t *mid)
+{
+    int total = 0;
+    for (const DirRecord &r : recs)
+        total += dirRecLen(static_cast<int>(r.name.size()));
+
+    std::size_t best = 0;
+    int best_diff = 0;
+    int left = 0;
+    for (std::size_t i = 1; i < recs.size(); ++i)
+    {
+        left += dirRecLen(static_cast<int>(recs[i - 1].name.size()));
+        if (recs[i].hash == recs[i - 1].hash || left > BLOCK_SIZE || total - left > BLOCK_SIZE)
+            continue;
+        int diff = std::abs(total - 2 * left);
+        if (best == 0 || diff < best_diff)
+        {
+            best = i;
+            best_diff = diff;
+        }
+    }
+    *mid = best;
+    return best != 0;
+}
+
+// 用 recs[from, to) 重新生成一个叶子块
+static void dir_fill_unit(char *buf, int len, const std::vector<DirRecord> &recs, std::size_t from, std::size_t to)
+{
+    dir_init_unit(buf, len);
+    for (std::size_t i = from; i < to; ++i)
+        dir_insert_unit(buf, len, recs[i].inode_id, recs[i].name, recs[i].type);
+}
 
 bool FileSystem::rm(const std::string &path, bool recursive, bool force, std::string &err)
 {
+    OpScope op(*this);
     err.clear();
     if (path.empty())
     {
@@ -50,22 +249,13 @@ bool FileSystem::rm(const std::string &path, bool recursive, bool force, std::st
 
         // 收集子项名称（跳过 . 和 ..）
         std::vector<std::string> children;
-        char block_buf[BLOCK_SIZE];
-        for (int i = 0; i < DIRECT_BLOCKS && node.i_direct[i] != -1; ++i)
+        forEachDirEntry_(node, [&children](const DirEntry &entry, const char *entry_name)
         {
-            disk.readBlock(node.i_direct[i], block_buf);
-            const DirEntry *entries = reinterpret_cast<const DirEntry *>(block_buf);
-            const int entry_count = BLOCK_SIZE / static_cast<int>(sizeof(DirEntry));
-            for (int j = 0; j < entry_count; ++j)
-            {
-                if (entries[j].d_inode_id == -1 || entries[j].d_name[0] == '\0')
-                    continue;
-                std::string name(entries[j].d_name);
-                if (name == "." || name == "..")
-                    continue;
+            std::string name(entry_name, entry.d_name_len);
+            if (name != "." && name != "..")
                 children.push_back(name);
-            }
-        }
+            return false;
+        });
 
         // 先递归删除子项
         for (const auto &name : children)
@@ -96,9 +286,9 @@ bool FileSystem::rm(const std::string &path, bool recursive, bool force, std::st
     return force;
 }
 
-FileSystem::FileSystem()
+FileSystem::FileSystem(DiskBackend backend)
+    : disk(backend), inode_bitmap(TOTAL_INODES, BLOCK_SIZE), data_bitmap(DISK_BLOCKS, BLOCK_SIZE)
 {
-    data_bitmap = new bool[DISK_BLOCKS]; // 应该根据super_block信息来定大小
     if (disk.diskExists())
     {
         mount();
@@ -113,14 +303,30 @@ FileSystem::FileSystem()
 FileSystem::~FileSystem()
 {
     // 在析构时可以考虑保存所有状态
-    saveSuperBlock();
-    saveBitmaps();
-    delete[] data_bitmap;
+    writeBackAll_(true);
+    // 正常卸载：做检查点，日志为空，下次挂载无需重放
+    if (journal_on_)
+        checkpointJournal_();
 }
 
 void FileSystem::format()
 {
+    // 旧磁盘内容即将被覆盖，缓存中的块和待丢弃的块全部作废
+    cache.invalidate();
+    icache_.clear();
+    for (PtrBlock &pb : ptr_cache_)
+        pb.block_id = -1;
+    pending_discard_.clear();
+    journal_on_ = false; // 旧日志作废，格式化结束后重新建立
+    txn_blocks_.clear();
+    txn_revoked_.clear();
+    txn_freed_.clear();
+    journaled_.clear();
+    dir_slot_hint_.clear();
+    dcache_.clear();
+    dcache_size_ = 0;
     disk.createDisk();
+    sb_on_disk_ = SuperBlock{}; // 新磁盘上超级块全为 0
 
     // 1. 初始化 SuperBlock
     super_block.s_total_blocks = DISK_BLOCKS;
@@ -129,16 +335,20 @@ void FileSystem::format()
     super_block.s_data_bitmap_start = DATA_BITMAP_START;
     super_block.s_inode_area_start = INODE_AREA_START;
     super_block.s_data_area_start = DATA_AREA_START;
+    // 磁盘是稀疏文件，inode 表和数据区都还没写过，记录下来按需初始化
+    super_block.s_flags = SB_LAZY_INIT;
+    super_block.s_itable_init_blocks = 0;
+    super_block.s_data_high_water = DATA_AREA_START;
+    super_block.s_version = FS_VERSION;
+    super_block.s_journal_start = 0;
+    super_block.s_journal_blocks = 0;
 
     // 2. 初始化位图
-    memset(inode_bitmap, 0, sizeof(inode_bitmap));
-    memset(data_bitmap, 0, DISK_BLOCKS * sizeof(bool));
+    inode_bitmap.clearAll();
+    data_bitmap.clearAll();
 
     // 标记系统占用的块
-    for (int i = 0; i < DATA_AREA_START; ++i)
-    {
-        data_bitmap[i] = true;
-    }
+    data_bitmap.setRange(0, DATA_AREA_START);
     super_block.s_free_blocks_count = DISK_BLOCKS - DATA_AREA_START;
     super_block.s_free_inodes_count = TOTAL_INODES;
 
@@ -151,51 +361,58 @@ void FileSystem::format()
     Inode root_inode;
     root_inode.i_id = root_inode_id;
     root_inode.i_type = DIRECTORY;
-    root_inode.i_size = 2 * sizeof(DirEntry); // . and ..
-    root_inode.i_blocks = 1;
     root_inode.i_ctime = root_inode.i_mtime = root_inode.i_atime = time(NULL);
-    root_inode.i_direct[0] = allocDataBlock();
-    for (int i = 1; i < DIRECT_BLOCKS; ++i)
-        root_inode.i_direct[i] = -1;
-    root_inode.i_indirect1 = -1;
+    initDirectory_(root_inode, root_inode_id, root_inode_id); // . 和 .. 都指向自身
 
     writeInode(root_inode_id, root_inode);
 
-    // 在根目录数据块中创建 . 和 ..
-    char block_buf[BLOCK_SIZE];
-    memset(block_buf, 0, BLOCK_SIZE);
-    DirEntry *dir_entries = (DirEntry *)block_buf;
-
-    strcpy(dir_entries[0].d_name, ".");
-    dir_entries[0].d_inode_id = root_inode_id;
-
-    strcpy(dir_entries[1].d_name, "..");
-    dir_entries[1].d_inode_id = root_inode_id;
-    int entry_count = BLOCK_SIZE / sizeof(DirEntry);
-    for (int k = 2; k < entry_count; ++k)
-    {
-        dir_entries[k].d_inode_id = -1;
-        dir_entries[k].d_name[0] = '\0';
-    }
-    disk.writeBlock(root_inode.i_direct[0], block_buf);
-
     // 删除原先多余的两行
     // inode.i_atime = inode.i_mtime = time(NULL);
     // writeInode(new_inode_id, inode);
 
-    // 4. 写入磁盘
-    saveSuperBlock();
-    saveBitmaps();
+    // 4. 写入磁盘，并在末尾建立日志区
+    if (!createJournal_())
+    {
+        syncMetadata_();
+        cache.flush();
+        disk.flush();
+    }
 
+    mounted_ = true;
     current_dir_inode_id = 0;
+    cwd_path_valid_ = false;
     std::cout << "Disk formatted successfully." << std::endl;
 }
 
 void FileSystem::mount()
 {
+    // 重新挂载前先写回内存中尚未保存的元数据，否则会被磁盘上的旧内容覆盖
+    if (mounted_ && journal_on_)
+    {
+        commitJournal_(true);
+        checkpointJournal_();
+    }
+    else if (mounted_)
+    {
+        syncMetadata_();
+    }
     loadSuperBlock();
+    recoverJournal_(); // 上次没有正常卸载时重放日志，之后磁盘上的元数据是一致的
     loadBitmaps();
+    if (super_block.s_version < FS_VERSION)
+    {
+        // 旧版本磁盘：按版本逐步升级 (位图已在 loadBitmaps 中转换)
+        if (super_block.s_version < 2)
+            upgradeInodes_();
+        if (super_block.s_version < 4)
+            upgradeDirectories_();
+        super_block.s_version = FS_VERSION;
+    }
+    if (!journal_on_ && !createJournal_())
+        std::cerr << "Warning: no room for the journal at the end of the disk, mounting without journal." << std::endl;
+    mounted_ = true;
     current_dir_inode_id = 0; // 默认当前目录是根目录
+    cwd_path_valid_ = false;
     std::cout << "File system mounted." << std::endl;
 }
 
@@ -205,6 +422,7 @@ void FileSystem::mount()
 
 int FileSystem::createFile(const std::string &path)
 {
+    OpScope op(*this);
     std::string filename;
     int parent_inode_id = resolvePath(path, filename);
     if (parent_inode_id < 0)
@@ -231,9 +449,9 @@ int FileSystem::createFile(const std::string &path)
     inode.i_size = 0;
     inode.i_blocks = 0;
     inode.i_ctime = inode.i_mtime = inode.i_atime = time(NULL);
-    for (int i = 0; i < DIRECT_BLOCKS; ++i)
-        inode.i_direct[i] = -1;
-    inode.i_indirect1 = -1;
+    // 新文件先内联存放，超出 INODE_INLINE_SIZE 后再改用区段映射
+    memset(inode.i_map_area, 0, sizeof(inode.i_map_area));
+    inode.i_flags = INODE_INLINE_DATA;
 
     writeInode(new_inode_id, inode);
     addDirEntry(parent_inode_id, filename, new_inode_id);
@@ -243,6 +461,7 @@ int FileSystem::createFile(const std::string &path)
 
 int FileSystem::createDirectory(const std::string &path)
 {
+    OpScope op(*this);
     std::string dirname;
     int parent_inode_id = resolvePath(path, dirname);
     if (parent_inode_id < 0)
@@ -263,37 +482,21 @@ int FileSystem::createDirectory(const std::string &path)
         return -1;
     }
 
-    // 创建新目录的inode
+    // 创建新目录的inode (内联存放 . 和 ..，条目多了再分配目录块)
     Inode inode;
     inode.i_id = new_inode_id;
     inode.i_type = DIRECTORY;
-    inode.i_size = 2 * sizeof(DirEntry);
-    inode.i_blocks = 1;
     inode.i_ctime = inode.i_mtime = inode.i_atime = time(NULL);
-    inode.i_direct[0] = allocDataBlock();
-    if (inode.i_direct[0] < 0)
+    initDirectory_(inode, new_inode_id, parent_inode_id);
+    writeInode(new_inode_id, inode);
+
+    // 在父目录中添加条目
+    if (!addDirEntry(parent_inode_id, dirname, new_inode_id))
     {
         freeInode(new_inode_id);
-        std::cerr << "Error: No free data block available." << std::endl;
+        std::cerr << "Error: Could not add directory entry." << std::endl;
         return -1;
     }
-    for (int i = 1; i < DIRECT_BLOCKS; ++i)
-        inode.i_direct[i] = -1;
-    inode.i_indirect1 = -1;
-    writeInode(new_inode_id, inode);
-
-    // 在父目录中添加条目
-    addDirEntry(parent_inode_id, dirname, new_inode_id);
-
-    // 在新目录的数据块中创建 . 和 ..
-    char block_buf[BLOCK_SIZE];
-    memset(block_buf, 0, BLOCK_SIZE);
-    DirEntry *dir_entries = (DirEntry *)block_buf;
-    strcpy(dir_entries[0].d_name, ".");
-    dir_entries[0].d_inode_id = new_inode_id;
-    strcpy(dir_entries[1].d_name, "..");
-    dir_entries[1].d_inode_id = parent_inode_id;
-    disk.writeBlock(inode.i_direct[0], block_buf);
 
     return new_inode_id;
 }
@@ -313,70 +516,204 @@ void FileSystem::listDirectory(const std::string &path)
         return;
     }
 
-    char block_buf[BLOCK_SIZE];
-    // 仅实现直接块的遍历
-    for (int i = 0; i < DIRECT_BLOCKS && inode.i_direct[i] != -1; ++i)
+    forEachDirEntry_(inode, [this](const DirEntry &entry, const char *entry_name)
     {
-        disk.readBlock(inode.i_direct[i], block_buf);
-        DirEntry *dir_entries = (DirEntry *)block_buf;
-        int entry_count = BLOCK_SIZE / sizeof(DirEntry);
-        for (int j = 0; j < entry_count; ++j)
+        std::string name(entry_name, entry.d_name_len);
+        if (entry.d_type == DIRECTORY)
         {
-            if (dir_entries[j].d_inode_id != -1 && strlen(dir_entries[j].d_name) > 0)
-            {
-                Inode entry_inode = readInode(dir_entries[j].d_inode_id);
-                if (entry_inode.i_type == DIRECTORY)
-                {
-                    std::cout << "d  " << dir_entries[j].d_name << "/" << std::endl;
-                }
-                else
-                {
-                    std::cout << "f  " << dir_entries[j].d_name << "  (" << entry_inode.i_size << " bytes)" << std::endl;
-                }
-            }
+            std::cout << "d  " << name << "/" << std::endl;
+        }
+        else
+        {
+            Inode entry_inode = readInode(entry.d_inode_id);
+            std::cout << "f  " << name << "  (" << entry_inode.i_size << " bytes)" << std::endl;
         }
+        return false;
+    });
+}
+
+FileReadView::FileReadView(FileReadView &&other) noexcept
+{
+    *this = std::move(other);
+}
+
+FileReadView &FileReadView::operator=(FileReadView &&other) noexcept
+{
+    if (this != &other)
+    {
+        release();
+        cache_ = other.cache_;
+        segments_ = std::move(other.segments_);
+        pinned_ = std::move(other.pinned_);
+        inline_ = std::move(other.inline_); // vector 移动后数据地址不变，段仍然有效
+        size_ = other.size_;
+        other.cache_ = nullptr;
+        other.segments_.clear();
+        other.pinned_.clear();
+        other.size_ = 0;
+    }
+    return *this;
+}
+
+void FileReadView::release()
+{
+    if (cache_)
+    {
+        for (int block_id : pinned_)
+            cache_->unpinBlock(block_id);
+    }
+    pinned_.clear();
+    segments_.clear();
+    inline_.clear();
+    size_ = 0;
+}
+
+int FileSystem::readView(int inode_id, int offset, int size, FileReadView &view)
+{
+    view.release();
+    view.cache_ = &cache;
+    Inode inode = readInode(inode_id);
+    if (inode.i_type != REGULAR_FILE || offset < 0)
+        return -1;
+    int read_size = std::min(size, inode.i_size - offset);
+    if (read_size <= 0)
+        return 0;
+
+    if (inode.i_flags & INODE_INLINE_DATA)
+    {
+        // 数据在 inode 里，inode 缓存项可能被淘汰，只能复制这几十个字节
+        read_size = std::min(read_size, INODE_INLINE_SIZE - offset);
+        if (read_size <= 0)
+            return 0;
+        view.inline_.assign(inode.i_inline + offset, inode.i_inline + offset + read_size);
+        view.segments_.emplace_back(view.inline_.data(), view.inline_.size());
+        view.size_ = read_size;
+        updateAtime_(inode_id);
+        return read_size;
+    }
+
+    // 空洞处的段指向共享的全 0 块
+    int first_block = offset / BLOCK_SIZE;
+    int last_block = (offset + read_size - 1) / BLOCK_SIZE;
+    std::vector<int> blocks;
+    mapRange_(inode, first_block, last_block - first_block + 1, blocks);
+    std::vector<int> mapped;
+    for (int block_id : blocks)
+    {
+        if (block_id >= 0)
+            mapped.push_back(block_id);
+    }
+    cache.prefetch(mapped);
+
+    int pos = offset;
+    int end = offset + read_size;
+    for (int block_id : blocks)
+    {
+        bool pinned = false;
+        const char *data = block_id < 0 ? ZERO_BLOCK : cache.pinBlock(block_id, &pinned);
+        if (!data)
+            break;
+        if (pinned)
+            view.pinned_.push_back(block_id);
+        int in_block = pos % BLOCK_SIZE;
+        int len = std::min(BLOCK_SIZE - in_block, end - pos);
+        const char *p = data + in_block;
+        // 映射区中物理相邻的块首尾相接，合并成一段
+        if (!view.segments_.empty() && view.segments_.back().data() + view.segments_.back().size() == p)
+            view.segments_.back() = std::string_view(view.segments_.back().data(), view.segments_.back().size() + len);
+        else
+            view.segments_.emplace_back(p, len);
+        view.size_ += len;
+        pos += len;
     }
+
+    updateAtime_(inode_id);
+    return static_cast<int>(view.size_);
 }
 
 int FileSystem::writeFile(int inode_id, const char *buf, int size, int offset)
 {
+    OpScope op(*this);
+    if (offset < 0)
+        return -1;
     Inode inode = readInode(inode_id);
     if (inode.i_type != REGULAR_FILE)
         return -1;
 
-    int bytes_written = 0;
-    char block_buf[BLOCK_SIZE];
-    // 极度简化的写入，仅支持直接块，且不支持扩展文件
-    while (bytes_written < size)
+    if (inode.i_flags & INODE_INLINE_DATA)
     {
-        int block_idx = (offset + bytes_written) / BLOCK_SIZE;
-        int block_offset = (offset + bytes_written) % BLOCK_SIZE;
-
-        if (block_idx >= DIRECT_BLOCKS)
+        if (offset + std::max(size, 0) <= INODE_INLINE_SIZE)
         {
-            std::cerr << "Error: File size exceeds direct block limit (simplification)." << std::endl;
-            break;
+            // 仍放得下：直接改 inode，不涉及数据块
+            if (size > 0)
+                memcpy(inode.i_inline + offset, buf, size);
+            inode.i_size = std::max(inode.i_size, offset + std::max(size, 0));
+            inode.i_mtime = time(NULL);
+            writeInode(inode_id, inode);
+            return std::max(size, 0);
         }
+        if (!inlineToBlocks_(inode))
+        {
+            std::cerr << "Error: No space left on device." << std::endl;
+            return 0;
+        }
+    }
 
-        int physical_block = inode.i_direct[block_idx];
-        if (physical_block == -1)
+    int bytes_written = 0;
+    // 先为涉及的所有块建立映射 (空洞处尽量分配连续的物理块)；
+    // 只有首尾未被完整覆盖的块需要读-改-写，中间的整块直接从 buf 写入
+    std::vector<int> blocks;
+    if (size > 0)
+    {
+        int first_block = offset / BLOCK_SIZE;
+        int last_block = (offset + size - 1) / BLOCK_SIZE;
+        int want = last_block - first_block + 1;
+        if (mapBlocks_(inode, first_block, want, true, blocks) < want)
         {
-            physical_block = allocDataBlock();
-            if (physical_block < 0)
-            {
+            if (super_block.s_free_blocks_count <= 0)
                 std::cerr << "Error: No space left on device." << std::endl;
-                break;
-            }
-            inode.i_direct[block_idx] = physical_block;
-            inode.i_blocks++;
+            else
+                std::cerr << "Error: File size exceeds block map limit (simplification)." << std::endl;
         }
 
-        disk.readBlock(physical_block, block_buf);
-        int write_len = std::min(BLOCK_SIZE - block_offset, size - bytes_written);
-        memcpy(block_buf + block_offset, buf + bytes_written, write_len);
-        disk.writeBlock(physical_block, block_buf);
+        if (!blocks.empty())
+        {
+            int n = static_cast<int>(blocks.size());
+            int block_offset = offset % BLOCK_SIZE;
+            bytes_written = std::min(size, n * BLOCK_SIZE - block_offset);
+            int tail = (block_offset + bytes_written) % BLOCK_SIZE;
+
+            // 不完整的首尾块 (新分配的块已在缓存中置 0，读取不会访问磁盘)
+            char block_buf[BLOCK_SIZE];
+            if (block_offset != 0)
+            {
+                cache.readBlock(blocks[0], block_buf);
+                memcpy(block_buf + block_offset, buf, std::min(BLOCK_SIZE - block_offset, bytes_written));
+                cache.writeBlock(blocks[0], block_buf);
+            }
+            if (tail != 0 && (n > 1 || block_offset == 0))
+            {
+                cache.readBlock(blocks[n - 1], block_buf);
+                memcpy(block_buf, buf + (n - 1) * BLOCK_SIZE - block_offset, tail);
+                cache.writeBlock(blocks[n - 1], block_buf);
+            }
 
-        bytes_written += write_len;
+            // 整块覆盖的部分：不读旧内容；够长时绕过缓存，由块层把物理连续的块合并成一次写。
+            // 提交之前就写到原位置是安全的：这些块要么本来就属于该文件，要么在已提交的状态里是空闲块
+            // (当前事务释放的块在提交前不会被再分配，见 freeDataBlock)
+            int first_full = block_offset != 0 ? 1 : 0;
+            int end_full = tail != 0 ? n - 1 : n;
+            if (end_full > first_full)
+            {
+                std::vector<int> full(blocks.begin() + first_full, blocks.begin() + end_full);
+                const char *src = buf + first_full * BLOCK_SIZE - block_offset;
+                if (end_full - first_full >= WRITE_THROUGH_BLOCKS)
+                    cache.writeBlocksThrough(full, src);
+                else
+                    cache.writeBlocks(full, src);
+            }
+            data_dirty_ = true;
+        }
     }
 
     inode.i_size = std::max(inode.i_size, offset + bytes_written);
@@ -388,6 +725,8 @@ int FileSystem::writeFile(int inode_id, const char *buf, int size, int offset)
 
 int FileSystem::readFile(int inode_id, char *buf, int size, int offset)
 {
+    if (offset < 0)
+        return -1;
     Inode inode = readInode(inode_id);
     if (inode.i_type != REGULAR_FILE)
         return -1;
@@ -397,28 +736,45 @@ int FileSystem::readFile(int inode_id, char *buf, int size, int offset)
     if (read_size <= 0)
         return 0;
 
-    char block_buf[BLOCK_SIZE];
-    // 极度简化的读取，仅支持直接块
-    while (bytes_read < read_size)
+    if (inode.i_flags & INODE_INLINE_DATA)
     {
-        int block_idx = (offset + bytes_read) / BLOCK_SIZE;
-        int block_offset = (offset + bytes_read) % BLOCK_SIZE;
-
-        if (block_idx >= DIRECT_BLOCKS || inode.i_direct[block_idx] == -1)
-        {
-            break;
-        }
+        read_size = std::min(read_size, INODE_INLINE_SIZE - offset);
+        if (read_size <= 0)
+            return 0;
+        memcpy(buf, inode.i_inline + offset, read_size);
+        updateAtime_(inode_id);
+        return read_size;
+    }
 
-        int physical_block = inode.i_direct[block_idx];
-        disk.readBlock(physical_block, block_buf);
-        int read_len = std::min(BLOCK_SIZE - block_offset, read_size - bytes_read);
-        memcpy(buf + bytes_read, block_buf + block_offset, read_len);
+    // 已映射的物理块一次批量读取，空洞直接填 0，不读盘
+    int first_block = offset / BLOCK_SIZE;
+    int last_block = (offset + read_size - 1) / BLOCK_SIZE;
+    std::vector<int> blocks;
+    mapRange_(inode, first_block, last_block - first_block + 1, blocks);
+    std::vector<int> mapped;
+    for (int block_id : blocks)
+    {
+        if (block_id >= 0)
+            mapped.push_back(block_id);
+    }
+    std::vector<char> data(mapped.size() * BLOCK_SIZE);
+    if (!mapped.empty())
+        cache.readBlocks(mapped, data.data());
 
-        bytes_read += read_len;
+    std::size_t next = 0;
+    for (int block_id : blocks)
+    {
+        int pos = offset + bytes_read;
+        int in_block = pos % BLOCK_SIZE;
+        int len = std::min(BLOCK_SIZE - in_block, read_size - bytes_read);
+        if (block_id < 0)
+            memset(buf + bytes_read, 0, len);
+        else
+            memcpy(buf + bytes_read, data.data() + next++ * BLOCK_SIZE + in_block, len);
+        bytes_read += len;
     }
 
-    inode.i_atime = time(NULL);
-    writeInode(inode_id, inode);
+    updateAtime_(inode_id);
 
     return bytes_read;
 }
@@ -438,13 +794,30 @@ void FileSystem::changeDirectory(const std::string &path)
         return;
     }
     current_dir_inode_id = inode_id;
+    cwd_path_valid_ = false;
 }
 
-std::string FileSystem::getCurrentPath() const
+void FileSystem::sync()
 {
+    writeBackAll_(true);
+}
+
+void FileSystem::tick()
+{
+    if (mounted_ && op_depth_ == 0 && mount_opts_.flush == FlushPolicy::PERIODIC && flushDue_())
+        writeBackAll_(false);
+}
+
+const std::string &FileSystem::getCurrentPath() const
+{
+    // 提示符每帧都要显示，只在失效后才重新回溯
+    if (cwd_path_valid_)
+        return cwd_path_;
+    cwd_path_valid_ = true;
     if (current_dir_inode_id == 0)
     {
-        return "/";
+        cwd_path_ = "/";
+        return cwd_path_;
     }
 
     std::vector<std::string> path_components;
@@ -463,25 +836,13 @@ std::string FileSystem::getCurrentPath() const
 
         // 在父目录中查找当前目录的名字
         Inode parent_inode = const_cast<FileSystem *>(this)->readInode(parent_inode_id);
-        char block_buf[BLOCK_SIZE];
-        bool found_name = false;
-        for (int i = 0; i < DIRECT_BLOCKS && parent_inode.i_direct[i] != -1; ++i)
+        const_cast<FileSystem *>(this)->forEachDirEntry_(parent_inode, [&](const DirEntry &entry, const char *entry_name)
         {
-            const_cast<FileSystem *>(this)->disk.readBlock(parent_inode.i_direct[i], block_buf);
-            DirEntry *entries = (DirEntry *)block_buf;
-            int entry_count = BLOCK_SIZE / sizeof(DirEntry);
-            for (int j = 0; j < entry_count; ++j)
-            {
-                if (entries[j].d_inode_id == temp_inode_id)
-                {
-                    path_components.push_back(entries[j].d_name);
-                    found_name = true;
-                    break;
-                }
-            }
-            if (found_name)
-                break;
-        }
+            if (entry.d_inode_id != temp_inode_id)
+                return false;
+            path_components.emplace_back(entry_name, entry.d_name_len);
+            return true;
+        });
 
         temp_inode_id = parent_inode_id;
     }
@@ -493,7 +854,8 @@ std::string FileSystem::getCurrentPath() const
         full_path += "/" + *it;
     }
 
-    return full_path.empty() ? "/" : full_path;
+    cwd_path_ = full_path.empty() ? "/" : full_path;
+    return cwd_path_;
 }
 
 // =================================================================
@@ -503,108 +865,1045 @@ std::string FileSystem::getCurrentPath() const
 void FileSystem::loadSuperBlock()
 {
     char buffer[BLOCK_SIZE];
-    disk.readBlock(SUPER_BLOCK_START, buffer);
+    cache.readBlock(SUPER_BLOCK_START, buffer);
     memcpy(&super_block, buffer, sizeof(SuperBlock));
+    sb_on_disk_ = super_block;
 }
 
 void FileSystem::saveSuperBlock()
 {
+    if (memcmp(&sb_on_disk_, &super_block, sizeof(SuperBlock)) == 0)
+        return;
+    sb_on_disk_ = super_block;
     char buffer[BLOCK_SIZE];
     memset(buffer, 0, BLOCK_SIZE);
     memcpy(buffer, &super_block, sizeof(SuperBlock));
-    disk.writeBlock(SUPER_BLOCK_START, buffer);
+    writeMetaBlock_(SUPER_BLOCK_START, buffer);
 }
 
 void FileSystem::loadBitmaps()
 {
-    char buffer[BLOCK_SIZE];
-    disk.readBlock(INODE_BITMAP_START, buffer);
-    memcpy(inode_bitmap, buffer, sizeof(inode_bitmap));
-
+    char inode_bytes[BLOCK_SIZE];
+    cache.readBlock(INODE_BITMAP_START, inode_bytes);
+    std::vector<char> bytes(static_cast<std::size_t>(DATA_BITMAP_BLOCKS) * BLOCK_SIZE);
     for (int i = 0; i < DATA_BITMAP_BLOCKS; ++i)
+        cache.readBlock(DATA_BITMAP_START + i, bytes.data() + i * BLOCK_SIZE);
+
+    if (super_block.s_version < 1)
+    {
+        // 旧格式：每个 inode / 块占一个 bool 字节，读入后按位重新编码
+        // (旧格式只保存了前 DATA_BITMAP_BLOCKS * BLOCK_SIZE 个数据块的状态)
+        inode_bitmap.clearAll();
+        for (int i = 0; i < TOTAL_INODES && i < BLOCK_SIZE; ++i)
+            if (inode_bytes[i])
+                inode_bitmap.set(i);
+        data_bitmap.clearAll();
+        for (int i = 0; i < DISK_BLOCKS && i < static_cast<int>(bytes.size()); ++i)
+            if (bytes[i])
+                data_bitmap.set(i);
+        data_bitmap.setRange(0, DATA_AREA_START);
+        // 转换后整块改写为按位格式
+        inode_bitmap.markAllDirty();
+        data_bitmap.markAllDirty();
+    }
+    else
     {
-        disk.readBlock(DATA_BITMAP_START + i, buffer);
-        memcpy((char *)data_bitmap + i * BLOCK_SIZE, buffer, BLOCK_SIZE);
+        inode_bitmap.fromBytes(inode_bytes, BLOCK_SIZE);
+        data_bitmap.fromBytes(bytes.data(), bytes.size());
     }
+
+    // 空闲计数以位图为准 (popcount)，防止超级块中的计数与位图不一致
+    super_block.s_free_inodes_count = TOTAL_INODES - inode_bitmap.count();
+    super_block.s_free_blocks_count = DISK_BLOCKS - data_bitmap.count();
 }
 
 void FileSystem::saveBitmaps()
 {
     char buffer[BLOCK_SIZE];
-    memset(buffer, 0, BLOCK_SIZE);
-    memcpy(buffer, inode_bitmap, sizeof(inode_bitmap));
-    disk.writeBlock(INODE_BITMAP_START, buffer);
+    for (int c = 0; c < inode_bitmap.chunkCount() && c < INODE_BITMAP_BLOCKS; ++c)
+    {
+        if (!inode_bitmap.chunkDirty(c))
+            continue;
+        inode_bitmap.chunkToBytes(c, buffer);
+        writeMetaBlock_(INODE_BITMAP_START + c, buffer);
+    }
+    inode_bitmap.clearDirty();
 
-    for (int i = 0; i < DATA_BITMAP_BLOCKS; ++i)
+    for (int c = 0; c < data_bitmap.chunkCount() && c < DATA_BITMAP_BLOCKS; ++c)
     {
-        memset(buffer, 0, BLOCK_SIZE);
-        memcpy(buffer, (char *)data_bitmap + i * BLOCK_SIZE, BLOCK_SIZE);
-        disk.writeBlock(DATA_BITMAP_START + i, buffer);
+        if (!data_bitmap.chunkDirty(c))
+            continue;
+        data_bitmap.chunkToBytes(c, buffer);
+        writeMetaBlock_(DATA_BITMAP_START + c, buffer);
     }
+    data_bitmap.clearDirty();
+}
+
+void FileSystem::syncMetadata_()
+{
+    flushInodes_(true); // 可能推进 s_itable_init_blocks，需在保存超级块之前
+    saveBitmaps();
+    saveSuperBlock();
 }
 
 int FileSystem::allocInode()
 {
-    for (int i = 0; i < TOTAL_INODES; ++i)
+    int i = inode_bitmap.allocate(0, TOTAL_INODES);
+    if (i < 0)
+        return -1; // No free inode
+    super_block.s_free_inodes_count--;
+    return i;
+}
+
+int FileSystem::allocDataBlock()
+{
+    int got = 0;
+    return allocDataBlocks(1, -1, &got);
+}
+
+int FileSystem::allocDataBlocks(int count, int goal, int *got)
+{
+    int start = data_bitmap.allocateRun(DATA_AREA_START, DISK_BLOCKS, goal, count, got);
+    if (start < 0 && journal_on_ && !txn_freed_.empty())
     {
-        if (!inode_bitmap[i])
-        {
-            inode_bitmap[i] = true;
-            super_block.s_free_inodes_count--;
-            return i;
-        }
+        // 剩下的空间都在等待提交的已释放块里：提前提交当前事务把它们放出来，再试一次
+        commitJournal_(false);
+        start = data_bitmap.allocateRun(DATA_AREA_START, DISK_BLOCKS, goal, count, got);
     }
-    return -1; // No free inode
+    if (start < 0)
+        return -1; // No free data block
+
+    super_block.s_free_blocks_count -= *got;
+    for (int i = start; i < start + *got; ++i)
+        prepareNewBlock_(i);
+    return start;
 }
 
-int FileSystem::allocDataBlock()
+void FileSystem::prepareNewBlock_(int block_id)
 {
-    for (int i = DATA_AREA_START; i < DISK_BLOCKS; ++i)
+    pending_discard_.erase(block_id);
+    if ((super_block.s_flags & SB_LAZY_INIT) && block_id >= super_block.s_data_high_water)
     {
-        if (!data_bitmap[i])
-        {
-            data_bitmap[i] = true;
-            super_block.s_free_blocks_count--;
-            return i;
-        }
+        // 从未写过的块：磁盘上必为 0，直接在缓存中放一个 0 块，省去首次读盘
+        super_block.s_data_high_water = block_id + 1;
+        cache.installZeroBlock(block_id, false);
+    }
+    else
+    {
+        // 释放时没有清零 (可能还在待丢弃集合中，或打洞前发生过崩溃)，
+        // 在缓存中就地清零；通常紧接着就会被新数据覆盖，不会多出一次写盘
+        cache.installZeroBlock(block_id, true);
     }
-    return -1; // No free data block
 }
 
 void FileSystem::freeDataBlock(int block_id)
 {
     if (block_id < DATA_AREA_START || block_id >= DISK_BLOCKS)
         return;
-    if (!data_bitmap[block_id])
+    if (!data_bitmap.test(block_id) || txn_freed_.count(block_id))
+        return;
+
+    journalForget_(block_id);
+    cache.discard(block_id);
+    dropPtrBlock_(block_id);
+    if (journal_on_)
+    {
+        // 提交之前磁盘上的一致状态里这个块仍属于原主人：位图位先保留，
+        // 不能立刻分配出去被覆盖，也不能打洞；由 commitJournal_ 真正释放
+        txn_freed_.insert(block_id);
+        if (static_cast<int>(txn_freed_.size()) >= DISCARD_BATCH_BLOCKS)
+            commit_pending_ = true;
         return;
+    }
 
-    data_bitmap[block_id] = false;
+    data_bitmap.clear(block_id);
     if (super_block.s_free_blocks_count < super_block.s_total_blocks)
         ++super_block.s_free_blocks_count;
 
-    char zero[BLOCK_SIZE] = {0};
-    disk.writeBlock(block_id, zero);
+    // 不再同步写 0：丢掉缓存内容，记入待丢弃集合，攒够一批再统一打洞
+    pending_discard_.insert(block_id);
+    if (static_cast<int>(pending_discard_.size()) >= DISCARD_BATCH_BLOCKS)
+        flushDiscards_();
 }
 
-Inode FileSystem::readInode(int inode_id)
+void FileSystem::flushDiscards_()
 {
-    Inode inode;
-    int block_offset = inode_id / INODES_PER_BLOCK;
-    int in_block_offset = inode_id % INODES_PER_BLOCK;
-    char buffer[BLOCK_SIZE];
-    disk.readBlock(INODE_AREA_START + block_offset, buffer);
-    memcpy(&inode, buffer + in_block_offset * INODE_SIZE, sizeof(Inode));
-    return inode;
+    if (pending_discard_.empty())
+        return;
+    std::vector<int> blocks(pending_discard_.begin(), pending_discard_.end());
+    disk.discardBlocks(blocks);
+    pending_discard_.clear();
+}
+
+// ---- 元数据日志 ----
+
+// 日志事务校验和 (FNV-1a，覆盖标签和内容块)
+static uint32_t journal_checksum(uint32_t h, const char *data, std::size_t len)
+{
+    for (std::size_t i = 0; i < len; ++i)
+    {
+        h ^= static_cast<unsigned char>(data[i]);
+        h *= 16777619u;
+    }
+    return h;
+}
+
+void FileSystem::writeMetaBlock_(int block_id, const char *buf)
+{
+    bool joining = journal_on_ && !txn_blocks_.count(block_id);
+    // 保证原位置上是事务开始前的内容：上一个事务提交的版本若还没写回，先写回
+    if (joining)
+        cache.writeBackBlock(block_id);
+    cache.writeBlock(block_id, buf);
+    if (!joining)
+        return;
+
+    bool pinned = false;
+    cache.pinBlock(block_id, &pinned); // 提交之前不能被淘汰写回
+    txn_blocks_.insert(block_id);
+    txn_revoked_.erase(block_id); // 本事务里的新副本会覆盖日志中的旧副本
+    if (static_cast<int>(txn_blocks_.size()) >= JOURNAL_COMMIT_BLOCKS)
+        commit_pending_ = true;
+}
+
+void FileSystem::journalForget_(int block_id)
+{
+    if (!journal_on_)
+        return;
+    if (txn_blocks_.erase(block_id))
+        cache.unpinBlock(block_id);
+    if (journaled_.count(block_id))
+        txn_revoked_.insert(block_id);
+}
+
+void FileSystem::opEnd_()
+{
+    bool due = commit_pending_; // 日志事务已经够大，不论策略都要提交
+    if (mount_opts_.flush == FlushPolicy::SYNC)
+        due = true;
+    else if (mount_opts_.flush == FlushPolicy::PERIODIC && flushDue_())
+        due = true;
+    if (due)
+        writeBackAll_(false);
+}
+
+bool FileSystem::flushDue_() const
+{
+    auto elapsed = std::chrono::steady_clock::now() - last_flush_;
+    return std::chrono::duration_cast<std::chrono::milliseconds>(elapsed).count() >= mount_opts_.flush_interval_ms;
+}
+
+void FileSystem::writeBackAll_(bool include_lazy)
+{
+    last_flush_ = std::chrono::steady_clock::now();
+    if (journal_on_)
+    {
+        commitJournal_(include_lazy);
+        return;
+    }
+    flushDiscards_();
+    flushInodes_(include_lazy);
+    saveBitmaps();
+    saveSuperBlock();
+    cache.flush();
+    disk.flush();
+    data_dirty_ = false;
+}
+
+void FileSystem::commitJournal_(bool include_lazy)
+{
+    // 本事务释放的块在这里才清位图位，随本事务一起提交，提交之后再打洞
+    for (int block_id : txn_freed_)
+    {
+        data_bitmap.clear(block_id);
+        if (super_block.s_free_blocks_count < super_block.s_total_blocks)
+            ++super_block.s_free_blocks_count;
+        pending_discard_.insert(block_id);
+    }
+    txn_freed_.clear();
+
+    // 内存中的 inode / 位图 / 超级块改动写入缓存，随本事务一起提交
+    flushInodes_(include_lazy);
+    saveBitmaps();
+    saveSuperBlock();
+    commit_pending_ = false;
+    if (txn_blocks_.empty() && txn_revoked_.empty())
+    {
+        // 没有元数据改动，只需把覆盖写的文件数据写回
+        if (data_dirty_)
+        {
+            cache.flush(true);
+            disk.flush();
+            data_dirty_ = false;
+        }
+        flushDiscards_();
+        return;
+    }
+
+    // 标签：先撤销记录，再是要记录内容的块
+    std::vector<uint32_t> tags;
+    for (int block_id : txn_revoked_)
+        tags.push_back(static_cast<uint32_t>(block_id) | JOURNAL_TAG_REVOKE);
+    for (int block_id : txn_blocks_)
+        tags.push_back(static_cast<uint32_t>(block_id));
+    int descriptors = (static_cast<int>(tags.size()) + JOURNAL_TAGS_PER_BLOCK - 1) / JOURNAL_TAGS_PER_BLOCK;
+    int total = descriptors + static_cast<int>(txn_blocks_.size()) + 1;
+
+    if (total > super_block.s_journal_blocks - 1)
+    {
+        // 单个事务超过整个日志区：只能直接写回原位置 (不保证原子性)
+        std::cerr << "Warning: transaction of " << total << " blocks exceeds the journal, writing in place." << std::endl;
+        for (int block_id : txn_blocks_)
+            cache.unpinBlock(block_id);
+        txn_blocks_.clear();
+        txn_revoked_.clear();
+        cache.flush();
+        disk.flush();
+        checkpointJournal_();
+        flushDiscards_();
+        return;
+    }
+    if (journal_head_ + total > super_block.s_journal_blocks)
+        checkpointJournal_(); // 当前事务的块仍被钉住，检查点不会写出未提交的内容
+
+    // 顺序模式：先把文件数据 (以及之前已提交的元数据) 写回原位置，
+    // 保证日志中的元数据不会指向尚未落盘的数据；数据要先落盘，再写提交块
+    // (否则掉电后已提交的事务可能指向从未写到存储上的数据)
+    cache.flush(true);
+    if (data_dirty_)
+        disk.flush();
+    data_dirty_ = false;
+
+    std::vector<char> buf(static_cast<std::size_t>(total) * BLOCK_SIZE, 0);
+    uint32_t sum = 2166136261u;
+    int pos = 0;
+    for (std::size_t t = 0; t < tags.size(); t += JOURNAL_TAGS_PER_BLOCK)
+    {
+        int n = std::min(JOURNAL_TAGS_PER_BLOCK, static_cast<int>(tags.size() - t));
+        char *desc = buf.data() + static_cast<std::size_t>(pos++) * BLOCK_SIZE;
+        JournalHeader *h = reinterpret_cast<JournalHeader *>(desc);
+        h->h_magic = JOURNAL_MAGIC;
+        h->h_type = JOURNAL_DESCRIPTOR;
+        h->h_seq = journal_seq_;
+        h->h_count = static_cast<uint32_t>(n);
+        memcpy(desc + sizeof(JournalHeader), &tags[t], n * sizeof(uint32_t));
+        sum = journal_checksum(sum, desc + sizeof(JournalHeader), n * sizeof(uint32_t));
+        for (int k = 0; k < n; ++k)
+        {
+            if (tags[t + k] & JOURNAL_TAG_REVOKE)
+                continue;
+            char *data = buf.data() + static_cast<std::size_t>(pos++) * BLOCK_SIZE;
+            cache.readBlock(static_cast<int>(tags[t + k]), data);
+            sum = journal_checksum(sum, data, BLOCK_SIZE);
+        }
+    }
+    JournalHeader *commit = reinterpret_cast<JournalHeader *>(buf.data() + static_cast<std::size_t>(pos) * BLOCK_SIZE);
+    commit->h_magic = JOURNAL_MAGIC;
+    commit->h_type = JOURNAL_COMMIT;
+    commit->h_seq = journal_seq_;
+    commit->h_count = static_cast<uint32_t>(txn_blocks_.size());
+    memcpy(commit + 1, &sum, sizeof(sum));
+
+    // 整个事务一次顺序写入日志区，只落盘一次；提交块的校验和可以识别写了一半的事务
+    disk.writeBlocks(super_block.s_journal_start + journal_head_, total, buf.data());
+    disk.flush();
+
+    for (int block_id : txn_blocks_)
+    {
+        cache.unpinBlock(block_id); // 已提交，之后随时可以写回原位置
+        journaled_.insert(block_id);
+    }
+    txn_blocks_.clear();
+    txn_revoked_.clear();
+    journal_head_ += total;
+    ++journal_seq_;
+    flushDiscards_(); // 释放已提交，可以打洞了
+
+    if (journal_head_ > super_block.s_journal_blocks * 3 / 4)
+        checkpointJournal_();
+}
+
+void FileSystem::checkpointJournal_()
+{
+    // 已提交的块写回原位置并落盘之后，才能让日志超级块跳过这些事务
+    cache.flush(true);
+    disk.flush();
+    journaled_.clear();
+    journal_head_ = 1;
+    writeJournalSuper_();
+    disk.flush();
+}
+
+void FileSystem::writeJournalSuper_()
+{
+    char buf[BLOCK_SIZE];
+    memset(buf, 0, BLOCK_SIZE);
+    JournalHeader *h = reinterpret_cast<JournalHeader *>(buf);
+    h->h_magic = JOURNAL_MAGIC;
+    h->h_type = JOURNAL_SUPER;
+    h->h_seq = journal_seq_;
+    h->h_count = static_cast<uint32_t>(super_block.s_journal_blocks);
+    disk.writeBlock(super_block.s_journal_start, buf);
+}
+
+bool FileSystem::createJournal_()
+{
+    int start = DISK_BLOCKS - JOURNAL_BLOCKS;
+    if (data_bitmap.findOne(start, DISK_BLOCKS) != DISK_BLOCKS)
+        return false;
+    data_bitmap.setRange(start, JOURNAL_BLOCKS);
+    super_block.s_free_blocks_count -= JOURNAL_BLOCKS;
+    super_block.s_journal_start = start;
+    super_block.s_journal_blocks = JOURNAL_BLOCKS;
+
+    // 预留结果 (以及格式化 / 升级写入的元数据) 直接写回原位置，再启用日志
+    syncMetadata_();
+    cache.flush();
+    disk.flush();
+    journal_seq_ = 1;
+    journal_head_ = 1;
+    writeJournalSuper_();
+    disk.flush();
+    journal_on_ = true;
+    return true;
+}
+
+void FileSystem::recoverJournal_()
+{
+    journal_on_ = false;
+    txn_blocks_.clear();
+    txn_revoked_.clear();
+    txn_freed_.clear();
+    journaled_.clear();
+    commit_pending_ = false;
+    if (super_block.s_journal_blocks <= 1 || super_block.s_journal_start <= 0 ||
+        super_block.s_journal_start + super_block.s_journal_blocks > DISK_BLOCKS)
+        return;
+
+    const int start = super_block.s_journal_start;
+    const int size = super_block.s_journal_blocks;
+    char buf[BLOCK_SIZE];
+    disk.readBlock(start, buf);
+    const JournalHeader *jsb = reinterpret_cast<const JournalHeader *>(buf);
+    uint32_t seq = (jsb->h_magic == JOURNAL_MAGIC && jsb->h_type == JOURNAL_SUPER) ? jsb->h_seq : 1;
+
+    // 第一遍：找出序号连续、校验和正确的事务，收集撤销记录
+    struct Record
+    {
+        uint32_t seq;
+        int home;
+        int pos;
+    };
+    std::vector<Record> records;
+    std::map<int, uint32_t> revoked; // 块号 -> 最后一次撤销所在事务
+    int pos = 1;
+    uint32_t next = seq;
+    while (pos < size)
+    {
+        std::vector<Record> txn;
+        std::vector<std::pair<int, uint32_t>> txn_revokes;
+        uint32_t sum = 2166136261u;
+        int p = pos;
+        bool committed = false;
+        while (p < size)
+        {
+            disk.readBlock(start + p, buf);
+            const JournalHeader *h = reinterpret_cast<const JournalHeader *>(buf);
+            if (h->h_magic != JOURNAL_MAGIC || h->h_seq != next)
+                break;
+            if (h->h_type == JOURNAL_COMMIT)
+            {
+                uint32_t stored = 0;
+                memcpy(&stored, h + 1, sizeof(stored));
+                committed = stored == sum && h->h_count == txn.size();
+                ++p;
+                break;
+            }
+            if (h->h_type != JOURNAL_DESCRIPTOR || h->h_count > static_cast<uint32_t>(JOURNAL_TAGS_PER_BLOCK))
+                break;
+            std::vector<uint32_t> tags(h->h_count);
+            memcpy(tags.data(), buf + sizeof(JournalHeader), tags.size() * sizeof(uint32_t));
+            sum = journal_checksum(sum, buf + sizeof(JournalHeader), tags.size() * sizeof(uint32_t));
+            ++p;
+            for (uint32_t tag : tags)
+            {
+                int home = static_cast<int>(tag & ~JOURNAL_TAG_REVOKE);
+                if (tag & JOURNAL_TAG_REVOKE)
+                {
+                    txn_revokes.emplace_back(home, next);
+                    continue;
+                }
+                if (p >= size)
+                    break;
+                disk.readBlock(start + p, buf);
+                sum = journal_checksum(sum, buf, BLOCK_SIZE);
+                txn.push_back({next, home, p});
+                ++p;
+            }
+        }
+        if (!committed)
+            break;
+        records.insert(records.end(), txn.begin(), txn.end());
+        for (const auto &r : txn_revokes)
+            revoked[r.first] = r.second;
+        pos = p;
+        ++next;
+    }
+
+    // 第二遍：按顺序重放，跳过之后又被释放 (撤销) 的块
+    int replayed = 0;
+    for (const Record &r : records)
+    {
+        auto it = revoked.find(r.home);
+        if ((it != revoked.end() && it->second >= r.seq) || r.home <= 0 || r.home >= DISK_BLOCKS)
+            continue;
+        disk.readBlock(start + r.pos, buf);
+        disk.writeBlock(r.home, buf);
+        ++replayed;
+    }
+    if (next != seq)
+    {
+        std::cout << "Journal: replayed " << (next - seq) << " transaction(s), " << replayed << " block(s)." << std::endl;
+        disk.flush();
+        cache.invalidate();
+        loadSuperBlock(); // 超级块本身可能刚被重放
+    }
+
+    // 日志清空，从下一个序号继续
+    journal_seq_ = next;
+    journal_head_ = 1;
+    writeJournalSuper_();
+    disk.flush();
+    journal_on_ = true;
+}
+
+Inode FileSystem::readInode(int inode_id)
+{
+    if (inode_id < 0 || inode_id >= TOTAL_INODES)
+    {
+        Inode inode;
+        memset(&inode, 0, sizeof(Inode));
+        return inode;
+    }
+    return lookupInode_(inode_id).inode;
 }
 
 void FileSystem::writeInode(int inode_id, const Inode &inode)
 {
+    if (inode_id < 0 || inode_id >= TOTAL_INODES)
+        return;
+    auto it = icache_.find(inode_id);
+    if (it == icache_.end())
+    {
+        // 整个 inode 都会被覆盖，无需先读盘
+        if (static_cast<int>(icache_.size()) >= INODE_CACHE_ENTRIES)
+            shrinkInodeCache_();
+        it = icache_.emplace(inode_id, CachedInode{}).first;
+    }
+    if (&it->second.inode != &inode)
+        it->second.inode = inode;
+    it->second.dirty = true;
+}
+
+FileSystem::CachedInode &FileSystem::lookupInode_(int inode_id)
+{
+    auto it = icache_.find(inode_id);
+    if (it != icache_.end())
+        return it->second;
+
+    if (static_cast<int>(icache_.size()) >= INODE_CACHE_ENTRIES)
+        shrinkInodeCache_();
+    CachedInode &entry = icache_[inode_id];
     int block_offset = inode_id / INODES_PER_BLOCK;
     int in_block_offset = inode_id % INODES_PER_BLOCK;
+    if ((super_block.s_flags & SB_LAZY_INIT) && block_offset >= super_block.s_itable_init_blocks)
+    {
+        // inode 表尚未初始化的部分，无需读盘
+        memset(&entry.inode, 0, sizeof(Inode));
+        return entry;
+    }
+    char buffer[BLOCK_SIZE];
+    cache.readBlock(INODE_AREA_START + block_offset, buffer);
+    memcpy(&entry.inode, buffer + in_block_offset * INODE_SIZE, sizeof(Inode));
+    return entry;
+}
+
+Inode &FileSystem::iget_(int inode_id)
+{
+    CachedInode &entry = lookupInode_(inode_id);
+    ++entry.refcount;
+    return entry.inode;
+}
+
+void FileSystem::iput_(int inode_id)
+{
+    auto it = icache_.find(inode_id);
+    if (it != icache_.end() && it->second.refcount > 0)
+        --it->second.refcount;
+}
+
+void FileSystem::flushInodes_(bool include_lazy)
+{
+    // 按 inode 表块分组，升序写回
+    std::map<int, std::vector<int>> by_block;
+    for (const auto &kv : icache_)
+    {
+        if (kv.second.dirty || (include_lazy && kv.second.time_dirty))
+            by_block[kv.first / INODES_PER_BLOCK].push_back(kv.first);
+    }
+    if (!include_lazy)
+    {
+        // 只有时间戳改动的 inode 搭便车：所在块反正要写
+        for (const auto &kv : icache_)
+        {
+            auto it = by_block.find(kv.first / INODES_PER_BLOCK);
+            if (!kv.second.dirty && kv.second.time_dirty && it != by_block.end())
+                it->second.push_back(kv.first);
+        }
+    }
+
     char buffer[BLOCK_SIZE];
-    disk.readBlock(INODE_AREA_START + block_offset, buffer);
-    memcpy(buffer + in_block_offset * INODE_SIZE, &inode, sizeof(Inode));
-    disk.writeBlock(INODE_AREA_START + block_offset, buffer);
+    for (const auto &group : by_block)
+    {
+        int block_offset = group.first;
+        if ((super_block.s_flags & SB_LAZY_INIT) && block_offset >= super_block.s_itable_init_blocks)
+        {
+            // 首次写入该 inode 表块：从全 0 开始，推进已初始化水位线
+            memset(buffer, 0, BLOCK_SIZE);
+            super_block.s_itable_init_blocks = block_offset + 1;
+        }
+        else
+        {
+            cache.readBlock(INODE_AREA_START + block_offset, buffer);
+        }
+        for (int inode_id : group.second)
+        {
+            CachedInode &entry = icache_[inode_id];
+            memcpy(buffer + (inode_id % INODES_PER_BLOCK) * INODE_SIZE, &entry.inode, sizeof(Inode));
+            entry.dirty = false;
+            entry.time_dirty = false;
+        }
+        writeMetaBlock_(INODE_AREA_START + block_offset, buffer);
+    }
+}
+
+void FileSystem::updateAtime_(int inode_id)
+{
+    if (mount_opts_.atime == AtimeMode::NOATIME || inode_id < 0 || inode_id >= TOTAL_INODES)
+        return;
+    CachedInode &entry = lookupInode_(inode_id);
+    Inode &inode = entry.inode;
+    time_t now = time(NULL);
+    if (mount_opts_.atime == AtimeMode::RELATIME && inode.i_atime > inode.i_mtime &&
+        inode.i_atime > inode.i_ctime && now - inode.i_atime < RELATIME_INTERVAL)
+        return;
+    if (inode.i_atime == now)
+        return;
+    inode.i_atime = now;
+    if (mount_opts_.lazytime)
+        entry.time_dirty = true;
+    else
+        entry.dirty = true;
+}
+
+void FileSystem::shrinkInodeCache_()
+{
+    flushInodes_(true);
+    for (auto it = icache_.begin(); it != icache_.end();)
+    {
+        if (it->second.refcount == 0)
+            it = icache_.erase(it);
+        else
+            ++it;
+    }
+}
+
+void FileSystem::upgradeInodes_()
+{
+    for (int inode_id = 0; inode_id < TOTAL_INODES; ++inode_id)
+    {
+        if (!inode_bitmap.test(inode_id))
+            continue;
+        Inode inode = readInode(inode_id);
+        if (inode.i_flags & INODE_EXTENTS)
+            continue;
+        inode.i_indirect2 = -1;
+        writeInode(inode_id, inode);
+    }
+}
+
+int FileSystem::bmap_(const Inode &inode, int logical)
+{
+    if (logical < 0)
+        return -1;
+    if (inode.i_flags & INODE_EXTENTS)
+    {
+        for (int k = 0; k < INODE_EXTENT_SLOTS && inode.i_extents[k].e_len > 0; ++k)
+        {
+            const Extent &e = inode.i_extents[k];
+            if (logical >= e.e_logical && logical < e.e_logical + e.e_len)
+                return e.e_start + (logical - e.e_logical);
+        }
+        return -1;
+    }
+    if (logical < DIRECT_BLOCKS)
+        return inode.i_direct[logical];
+    // create 为 false 时 ptrBlockFor_ 不会修改 inode
+    int index = 0;
+    int ptr_block = ptrBlockFor_(const_cast<Inode &>(inode), logical, false, &index);
+    return ptr_block < 0 ? -1 : loadPtrBlock_(ptr_block).ptrs[index];
+}
+
+int FileSystem::mapBlocks_(Inode &inode, int first, int count, bool create, std::vector<int> &phys)
+{
+    phys.clear();
+    if (inode.i_flags & INODE_INLINE_DATA)
+        return 0; // 内联文件没有数据块，调用者需先 inlineToBlocks_
+    int i = 0;
+    while (i < count)
+    {
+        int p = bmap_(inode, first + i);
+        if (p >= 0)
+        {
+            phys.push_back(p);
+            ++i;
+            continue;
+        }
+        if (!create)
+            break;
+
+        // 空洞：统计连续未映射的块数，一次分配一段
+        int want = 1;
+        while (i + want < count && bmap_(inode, first + i + want) < 0)
+            ++want;
+        want = std::min(want, MAX_MAPPED_BLOCKS - (first + i));
+        if (want <= 0)
+            break;
+
+        // 目标位置紧跟前一个逻辑块的物理块，使文件在磁盘上保持连续
+        int prev = bmap_(inode, first + i - 1);
+        int goal = prev >= 0 ? prev + 1 : -1;
+        int got = 0;
+        int start = allocDataBlocks(want, goal, &got);
+        if (start < 0)
+            break;
+
+        int recorded = setMapping_(inode, first + i, start, got);
+        for (int k = recorded; k < got; ++k)
+            freeDataBlock(start + k); // 映射表已满，退还记录不下的块
+        inode.i_blocks += recorded;
+        for (int k = 0; k < recorded; ++k)
+            phys.push_back(start + k);
+        i += recorded;
+        if (recorded < got)
+            break;
+    }
+    return static_cast<int>(phys.size());
+}
+
+void FileSystem::mapRange_(const Inode &inode, int first, int count, std::vector<int> &phys)
+{
+    phys.assign(count, -1);
+    if (inode.i_flags & INODE_INLINE_DATA)
+        return;
+    for (int i = 0; i < count; ++i)
+        phys[i] = bmap_(inode, first + i);
+}
+
+int FileSystem::nextMapped_(const Inode &inode, int logical, int end, bool mapped)
+{
+    if (inode.i_flags & INODE_EXTENTS)
+    {
+        // 区段按逻辑块升序排列，直接在区段边界上跳
+        for (int k = 0; k < INODE_EXTENT_SLOTS && inode.i_extents[k].e_len > 0 && logical < end; ++k)
+        {
+            const Extent &e = inode.i_extents[k];
+            if (logical >= e.e_logical + e.e_len)
+                continue;
+            if (logical < e.e_logical)
+            {
+                if (!mapped)
+                    return logical;
+                logical = e.e_logical;
+            }
+            if (mapped)
+                return std::min(logical, end);
+            logical = e.e_logical + e.e_len;
+        }
+        return mapped ? end : std::min(logical, end);
+    }
+    while (logical < end && (bmap_(inode, logical) >= 0) != mapped)
+        ++logical;
+    return logical;
+}
+
+int FileSystem::setMapping_(Inode &inode, int logical, int start, int len)
+{
+    if (len <= 0)
+        return 0;
+    if (!(inode.i_flags & INODE_EXTENTS))
+    {
+        int n = 0;
+        while (n < len)
+        {
+            int l = logical + n;
+            if (l < DIRECT_BLOCKS)
+            {
+                inode.i_direct[l] = start + n;
+                ++n;
+                continue;
+            }
+            // 同一指针块内的连续逻辑块一次填好，只写回一次
+            int index = 0;
+            int ptr_block = ptrBlockFor_(inode, l, true, &index);
+            if (ptr_block < 0)
+                break;
+            PtrBlock &pb = loadPtrBlock_(ptr_block);
+            int m = std::min(len - n, POINTERS_PER_BLOCK - index);
+            for (int k = 0; k < m; ++k)
+                pb.ptrs[index + k] = start + n + k;
+            storePtrBlock_(pb);
+            n += m;
+        }
+        return n;
+    }
+
+    Extent *ext = inode.i_extents;
+    int used = 0;
+    while (used < INODE_EXTENT_SLOTS && ext[used].e_len > 0)
+        ++used;
+    // 插入位置：第一个起始逻辑块大于 logical 的区段
+    int pos = 0;
+    while (pos < used && ext[pos].e_logical < logical)
+        ++pos;
+
+    bool joins_prev = pos > 0 && ext[pos - 1].e_logical + ext[pos - 1].e_len == logical &&
+                      ext[pos - 1].e_start + ext[pos - 1].e_len == start;
+    bool joins_next = pos < used && ext[pos].e_logical == logical + len && ext[pos].e_start == start + len;
+    if (joins_prev)
+    {
+        ext[pos - 1].e_len += len;
+        if (joins_next)
+        {
+            // 填上了两个区段之间的空洞，合并成一个
+            ext[pos - 1].e_len += ext[pos].e_len;
+            for (int k = pos; k + 1 < used; ++k)
+                ext[k] = ext[k + 1];
+            ext[used - 1] = Extent{0, 0, 0};
+        }
+        return len;
+    }
+    if (joins_next)
+    {
+        ext[pos].e_logical = logical;
+        ext[pos].e_start = start;
+        ext[pos].e_len += len;
+        return len;
+    }
+    if (used < INODE_EXTENT_SLOTS)
+    {
+        for (int k = used; k > pos; --k)
+            ext[k] = ext[k - 1];
+        ext[pos] = Extent{logical, start, len};
+        return len;
+    }
+    // 区段槽位已满：转换为直接/间接块映射后再记录
+    if (extentsToBlockMap_(inode))
+        return setMapping_(inode, logical, start, len);
+    return 0;
+}
+
+bool FileSystem::inlineToBlocks_(Inode &inode)
+{
+    char saved[INODE_INLINE_SIZE];
+    memcpy(saved, inode.i_inline, sizeof(saved));
+    int saved_flags = inode.i_flags;
+
+    memset(inode.i_map_area, 0, sizeof(inode.i_map_area));
+    inode.i_flags = (inode.i_flags & ~INODE_INLINE_DATA) | INODE_EXTENTS;
+    if (inode.i_size <= 0)
+        return true;
+
+    std::vector<int> blocks;
+    if (mapBlocks_(inode, 0, 1, true, blocks) < 1)
+    {
+        memcpy(inode.i_inline, saved, sizeof(saved));
+        inode.i_flags = saved_flags;
+        return false;
+    }
+    // 新分配的块在缓存中已是全 0，写入原内联数据即可
+    char block_buf[BLOCK_SIZE];
+    memset(block_buf, 0, BLOCK_SIZE);
+    memcpy(block_buf, saved, std::min(inode.i_size, INODE_INLINE_SIZE));
+    // 这是文件数据而不是元数据：不进日志 (否则之后原位覆盖的内容会被重放的旧副本盖掉)，
+    // 和其他数据块一样在提交前写回
+    cache.writeBlock(blocks[0], block_buf);
+    data_dirty_ = true;
+    return true;
+}
+
+bool FileSystem::extentsToBlockMap_(Inode &inode)
+{
+    Extent saved[INODE_EXTENT_SLOTS];
+    int used = 0;
+    int end = 0;
+    for (; used < INODE_EXTENT_SLOTS && inode.i_extents[used].e_len > 0; ++used)
+    {
+        saved[used] = inode.i_extents[used];
+        end = std::max(end, saved[used].e_logical + saved[used].e_len);
+    }
+    if (end > MAX_MAPPED_BLOCKS)
+        return false;
+    // 先确认指针块放得下 (按覆盖 [0, end) 估算上界)，避免转换到一半失败
+    int need = 0;
+    if (end > DIRECT_BLOCKS)
+        ++need;
+    if (end > DIRECT_BLOCKS + POINTERS_PER_BLOCK)
+        need += 1 + (end - DIRECT_BLOCKS - POINTERS_PER_BLOCK + POINTERS_PER_BLOCK - 1) / POINTERS_PER_BLOCK;
+    if (super_block.s_free_blocks_count < need)
+        return false;
+
+    memset(inode.i_map_area, 0, sizeof(inode.i_map_area));
+    for (int i = 0; i < DIRECT_BLOCKS; ++i)
+        inode.i_direct[i] = -1;
+    inode.i_indirect1 = -1;
+    inode.i_indirect2 = -1;
+    inode.i_flags &= ~INODE_EXTENTS;
+    for (int k = 0; k < used; ++k)
+        setMapping_(inode, saved[k].e_logical, saved[k].e_start, saved[k].e_len);
+    return true;
+}
+
+int FileSystem::ptrBlockFor_(Inode &inode, int logical, bool create, int *index)
+{
+    if (logical < DIRECT_BLOCKS || logical >= MAX_MAPPED_BLOCKS)
+        return -1;
+    int rel = logical - DIRECT_BLOCKS;
+    if (rel < POINTERS_PER_BLOCK)
+    {
+        *index = rel;
+        if (inode.i_indirect1 < 0 && create)
+            inode.i_indirect1 = newPtrBlock_(inode);
+        return inode.i_indirect1;
+    }
+
+    rel -= POINTERS_PER_BLOCK;
+    *index = rel % POINTERS_PER_BLOCK;
+    int outer = rel / POINTERS_PER_BLOCK;
+    if (inode.i_indirect2 < 0)
+    {
+        if (!create)
+            return -1;
+        inode.i_indirect2 = newPtrBlock_(inode);
+        if (inode.i_indirect2 < 0)
+            return -1;
+    }
+    int leaf = loadPtrBlock_(inode.i_indirect2).ptrs[outer];
+    if (leaf < 0 && create)
+    {
+        leaf = newPtrBlock_(inode);
+        if (leaf < 0)
+            return -1;
+        // newPtrBlock_ 可能占用了顶层块所在的缓存槽，重新取
+        PtrBlock &top = loadPtrBlock_(inode.i_indirect2);
+        top.ptrs[outer] = leaf;
+        storePtrBlock_(top);
+    }
+    return leaf;
+}
+
+int FileSystem::newPtrBlock_(Inode &inode)
+{
+    int block_id = allocDataBlock();
+    if (block_id < 0)
+        return -1;
+    PtrBlock &pb = ptr_cache_[block_id % BMAP_CACHE_BLOCKS];
+    pb.block_id = block_id;
+    std::fill(pb.ptrs, pb.ptrs + POINTERS_PER_BLOCK, -1);
+    storePtrBlock_(pb);
+    inode.i_blocks++;
+    return block_id;
+}
+
+FileSystem::PtrBlock &FileSystem::loadPtrBlock_(int block_id)
+{
+    PtrBlock &pb = ptr_cache_[block_id % BMAP_CACHE_BLOCKS];
+    if (pb.block_id != block_id)
+    {
+        cache.readBlock(block_id, reinterpret_cast<char *>(pb.ptrs));
+        pb.block_id = block_id;
+    }
+    return pb;
+}
+
+void FileSystem::storePtrBlock_(const PtrBlock &pb)
+{
+    writeMetaBlock_(pb.block_id, reinterpret_cast<const char *>(pb.ptrs));
+}
+
+void FileSystem::dropPtrBlock_(int block_id)
+{
+    PtrBlock &pb = ptr_cache_[block_id % BMAP_CACHE_BLOCKS];
+    if (pb.block_id == block_id)
+        pb.block_id = -1;
+}
+
+void FileSystem::releaseBlocks_(Inode &inode)
+{
+    if (inode.i_flags & INODE_INLINE_DATA)
+    {
+        memset(inode.i_map_area, 0, sizeof(inode.i_map_area));
+        return;
+    }
+    if (inode.i_flags & INODE_EXTENTS)
+    {
+        for (int k = 0; k < INODE_EXTENT_SLOTS && inode.i_extents[k].e_len > 0; ++k)
+        {
+            const Extent &e = inode.i_extents[k];
+            for (int b = 0; b < e.e_len; ++b)
+                freeDataBlock(e.e_start + b);
+        }
+        memset(inode.i_map_area, 0, sizeof(inode.i_map_area));
+        return;
+    }
+    for (int i = 0; i < DIRECT_BLOCKS; ++i)
+    {
+        if (inode.i_direct[i] != -1)
+        {
+            freeDataBlock(inode.i_direct[i]);
+            inode.i_direct[i] = -1;
+        }
+    }
+
+    // 释放一个末级指针块及其指向的数据块 (先复制指针，释放会使缓存槽失效)
+    auto release_leaf = [this](int ptr_block)
+    {
+        const PtrBlock &pb = loadPtrBlock_(ptr_block);
+        std::vector<int> ptrs(pb.ptrs, pb.ptrs + POINTERS_PER_BLOCK);
+        for (int p : ptrs)
+        {
+            if (p >= 0)
+                freeDataBlock(p);
+        }
+        freeDataBlock(ptr_block);
+    };
+    if (inode.i_indirect1 >= 0)
+    {
+        release_leaf(inode.i_indirect1);
+        inode.i_indirect1 = -1;
+    }
+    if (inode.i_indirect2 >= 0)
+    {
+        const PtrBlock &top = loadPtrBlock_(inode.i_indirect2);
+        std::vector<int> leaves(top.ptrs, top.ptrs + POINTERS_PER_BLOCK);
+        for (int leaf : leaves)
+        {
+            if (leaf >= 0)
+                release_leaf(leaf);
+        }
+        freeDataBlock(inode.i_indirect2);
+        inode.i_indirect2 = -1;
+    }
 }
 
 int FileSystem::resolvePath(const std::string &path, std::string &last_component)
@@ -631,154 +1930,557 @@ int FileSystem::resolvePath(const std::string &path, std::string &last_component
         last_component = path.substr(last_slash + 1);
     }
 
-    return findInodeByPath(parent_path);
+    return findInodeByPath(parent_path);
+}
+
+int FileSystem::findInodeByPath(const std::string &path)
+{
+    if (path.empty())
+        return -1;
+
+    int current_inode = (path[0] == '/') ? 0 : current_dir_inode_id;
+
+    if (path == "/")
+        return 0;
+    if (path == ".")
+        return current_dir_inode_id;
+    if (path == "..")
+    {
+        return findInDir(current_dir_inode_id, "..");
+    }
+
+    std::string p = path;
+    if (p[0] == '/')
+        p = p.substr(1);
+
+    size_t start = 0;
+    size_t end = p.find('/');
+
+    while (end != std::string::npos)
+    {
+        std::string component = p.substr(start, end - start);
+        current_inode = findInDir(current_inode, component);
+        if (current_inode < 0)
+            return -1;
+        Inode inode = readInode(current_inode);
+        if (inode.i_type != DIRECTORY)
+            return -1;
+        start = end + 1;
+        end = p.find('/', start);
+    }
+
+    std::string last_component = p.substr(start);
+    return findInDir(current_inode, last_component);
+}
+
+int FileSystem::findInDir(int dir_inode_id, const std::string &filename)
+{
+    auto group = dcache_.find(dir_inode_id);
+    if (group != dcache_.end())
+    {
+        auto it = group->second.find(filename);
+        if (it != group->second.end())
+        {
+            ++dcache_stats_.hits;
+            return it->second;
+        }
+    }
+    ++dcache_stats_.misses;
+
+    Inode dir_inode = readInode(dir_inode_id);
+    if (dir_inode.i_type != DIRECTORY)
+        return -1;
+    int inode_id = lookupDirEntry_(dir_inode, filename);
+    dcacheSet_(dir_inode_id, filename, inode_id);
+    return inode_id;
+}
+
+void FileSystem::dcacheSet_(int dir_inode_id, const std::string &name, int inode_id)
+{
+    auto &group = dcache_[dir_inode_id];
+    auto it = group.find(name);
+    if (it != group.end())
+    {
+        it->second = inode_id;
+        return;
+    }
+    if (dcache_size_ >= static_cast<std::size_t>(DENTRY_CACHE_ENTRIES))
+    {
+        dcache_.clear();
+        dcache_size_ = 0;
+    }
+    dcache_[dir_inode_id].emplace(name, inode_id);
+    ++dcache_size_;
+}
+
+void FileSystem::dcacheDropDir_(int dir_inode_id)
+{
+    auto group = dcache_.find(dir_inode_id);
+    if (group == dcache_.end())
+        return;
+    dcache_size_ -= group->second.size();
+    dcache_.erase(group);
+}
+
+int FileSystem::lookupDirEntry_(Inode &dir_inode, const std::string &filename)
+{
+    if (dir_inode.i_flags & INODE_DIR_INDEX)
+    {
+        char root_buf[BLOCK_SIZE];
+        if (dxLoadRoot_(dir_inode, root_buf))
+            return dxFind_(dir_inode, root_buf, filename);
+    }
+
+    int found = -1;
+    forEachDirEntry_(dir_inode, [&](const DirEntry &entry, const char *entry_name)
+    {
+        if (entry.d_name_len != filename.size() || memcmp(entry_name, filename.data(), filename.size()) != 0)
+            return false;
+        found = entry.d_inode_id;
+        return true;
+    });
+    return found;
+}
+
+bool FileSystem::addDirEntry(int dir_inode_id, const std::string &filename, int new_inode_id)
+{
+    if (filename.empty() || filename.size() > static_cast<std::size_t>(DIR_NAME_MAX))
+        return false;
+    Inode dir_inode = readInode(dir_inode_id);
+    if (dir_inode.i_type != DIRECTORY)
+        return false;
+    int type = readInode(new_inode_id).i_type;
+
+    bool added = false;
+    if (dir_inode.i_flags & INODE_INLINE_DATA)
+    {
+        added = dir_insert_unit(dir_inode.i_inline, INODE_INLINE_SIZE, new_inode_id, filename, type);
+        if (!added && !inlineDirToBlock_(dir_inode))
+            return false;
+    }
+
+    if (!added && (dir_inode.i_flags & INODE_DIR_INDEX))
+    {
+        char root_buf[BLOCK_SIZE];
+        if (dxLoadRoot_(dir_inode, root_buf))
+        {
+            int r = dxAdd_(dir_inode, root_buf, new_inode_id, filename, type);
+            if (r < 0)
+            {
+                writeInode(dir_inode_id, dir_inode);
+                return false;
+            }
+            if (r == 0)
+                dir_inode.i_flags &= ~INODE_DIR_INDEX; // 索引放不下了，之后按线性目录处理
+            added = r > 0;
+        }
+    }
+
+    if (!added)
+    {
+        // 先复用已有目录块中的空闲空间，从上次记下的块开始找
+        int nblocks = dir_inode.i_size / BLOCK_SIZE;
+        std::vector<int> blocks;
+        mapBlocks_(dir_inode, 0, nblocks, false, blocks);
+        auto hint = dir_slot_hint_.find(dir_inode_id);
+        int start = (hint != dir_slot_hint_.end() && hint->second < static_cast<int>(blocks.size())) ? hint->second : 0;
+        char block_buf[BLOCK_SIZE];
+        for (int k = 0; k < static_cast<int>(blocks.size()); ++k)
+        {
+            int idx = (start + k) % static_cast<int>(blocks.size());
+            cache.readBlock(blocks[idx], block_buf);
+            if (dir_insert_unit(block_buf, BLOCK_SIZE, new_inode_id, filename, type))
+            {
+                writeMetaBlock_(blocks[idx], block_buf);
+                dir_slot_hint_[dir_inode_id] = idx;
+                added = true;
+                break;
+            }
+        }
+
+        // 唯一的目录块也写满了：改为带索引的目录
+        if (!added && nblocks == 1 && !(dir_inode.i_flags & INODE_DIR_INDEX))
+            added = dxBuildIndex_(dir_inode, new_inode_id, filename, type);
+
+        if (!added)
+        {
+            // 都满了：在末尾追加一个目录块
+            nblocks = dir_inode.i_size / BLOCK_SIZE;
+            if (mapBlocks_(dir_inode, nblocks, 1, true, blocks) < 1)
+            {
+                writeInode(dir_inode_id, dir_inode); // 可能刚从内联转换过
+                return false;
+            }
+            dir_init_unit(block_buf, BLOCK_SIZE);
+            dir_insert_unit(block_buf, BLOCK_SIZE, new_inode_id, filename, type);
+            writeMetaBlock_(blocks[0], block_buf);
+            dir_inode.i_size += BLOCK_SIZE;
+            dir_slot_hint_[dir_inode_id] = nblocks;
+        }
+    }
+
+    dir_inode.i_mtime = dir_inode.i_atime = time(NULL);
+    writeInode(dir_inode_id, dir_inode);
+    dcacheSet_(dir_inode_id, filename, new_inode_id);
+    return true;
+}
+
+bool FileSystem::dxLoadRoot_(Inode &dir, char *root_buf)
+{
+    int nblocks = dir.i_size / BLOCK_SIZE;
+    std::vector<int> blocks;
+    if (nblocks >= 2 && mapBlocks_(dir, 0, 1, false, blocks) == 1)
+    {
+        cache.readBlock(blocks[0], root_buf);
+        const DirEntry *fake = reinterpret_cast<const DirEntry *>(root_buf + DX_FAKE_OFFSET);
+        const DirIndexRoot *root = dx_root(root_buf);
+        const DirIndexEntry *entries = dx_entries(root_buf);
+        bool ok = fake->d_inode_id == -1 && fake->d_rec_len == BLOCK_SIZE - DX_FAKE_OFFSET &&
+                  root->dx_magic == DIR_INDEX_MAGIC && root->dx_limit == DX_LIMIT &&
+                  root->dx_count >= 1 && root->dx_count <= root->dx_limit && entries[0].dx_hash == 0;
+        for (int i = 0; ok && i < root->dx_count; ++i)
+        {
+            ok = entries[i].dx_block >= 1 && entries[i].dx_block < static_cast<uint32_t>(nblocks) &&
+                 (i == 0 || entries[i].dx_hash > entries[i - 1].dx_hash);
+        }
+        if (ok)
+            return true;
+    }
+
+    std::cerr << "Warning: directory index of inode " << dir.i_id << " is corrupt, using linear lookup." << std::endl;
+    dir.i_flags &= ~INODE_DIR_INDEX;
+    writeInode(dir.i_id, dir);
+    return false;
+}
+
+int FileSystem::dxFind_(Inode &dir, const char *root_buf, const std::string &name)
+{
+    int found = -1;
+    auto match = [&](const DirEntry &entry, const char *entry_name)
+    {
+        if (entry.d_name_len != name.size() || memcmp(entry_name, name.data(), name.size()) != 0)
+            return false;
+        found = entry.d_inode_id;
+        return true;
+    };
+
+    // . 和 .. 只在索引根所在的块里
+    if (name == "." || name == "..")
+    {
+        dir_scan_unit(root_buf, DX_FAKE_OFFSET, match);
+        return found;
+    }
+
+    char *root = const_cast<char *>(root_buf);
+    int slot = dx_find_slot(dx_entries(root), dx_root(root)->dx_count, dir_name_hash(name.data(), name.size()));
+    std::vector<int> blocks;
+    if (mapBlocks_(dir, static_cast<int>(dx_entries(root)[slot].dx_block), 1, false, blocks) < 1)
+        return -1;
+    char leaf_buf[BLOCK_SIZE];
+    cache.readBlock(blocks[0], leaf_buf);
+    dir_scan_unit(leaf_buf, BLOCK_SIZE, match);
+    return found;
 }
 
-int FileSystem::findInodeByPath(const std::string &path)
+int FileSystem::dxAdd_(Inode &dir, char *root_buf, int inode_id, const std::string &name, int type)
 {
-    if (path.empty())
-        return -1;
+    DirIndexRoot *root = dx_root(root_buf);
+    DirIndexEntry *entries = dx_entries(root_buf);
+    uint32_t hash = dir_name_hash(name.data(), name.size());
+    int slot = dx_find_slot(entries, root->dx_count, hash);
 
-    int current_inode = (path[0] == '/') ? 0 : current_dir_inode_id;
-
-    if (path == "/")
+    std::vector<int> leaf;
+    if (mapBlocks_(dir, static_cast<int>(entries[slot].dx_block), 1, false, leaf) < 1)
         return 0;
-    if (path == ".")
-        return current_dir_inode_id;
-    if (path == "..")
+    char leaf_buf[BLOCK_SIZE];
+    cache.readBlock(leaf[0], leaf_buf);
+    if (dir_insert_unit(leaf_buf, BLOCK_SIZE, inode_id, name, type))
     {
-        return findInDir(current_dir_inode_id, "..");
+        writeMetaBlock_(leaf[0], leaf_buf);
+        return 1;
     }
 
-    std::string p = path;
-    if (p[0] == '/')
-        p = p.substr(1);
+    // 叶子满了：按哈希分裂成两块，上半部分搬到目录末尾新分配的块
+    if (root->dx_count >= root->dx_limit)
+        return 0;
+    std::vector<DirRecord> recs;
+    dir_collect_unit(leaf_buf, BLOCK_SIZE, recs);
+    recs.push_back({hash, inode_id, type, name});
+    std::sort(recs.begin(), recs.end(), [](const DirRecord &a, const DirRecord &b) { return a.hash < b.hash; });
+    std::size_t mid = 0;
+    if (!dir_split_records(recs, &mid))
+        return 0;
 
-    size_t start = 0;
-    size_t end = p.find('/');
+    int new_logical = dir.i_size / BLOCK_SIZE;
+    std::vector<int> fresh;
+    if (mapBlocks_(dir, new_logical, 1, true, fresh) < 1)
+        return -1;
+    dir.i_size += BLOCK_SIZE;
+
+    dir_fill_unit(leaf_buf, BLOCK_SIZE, recs, 0, mid);
+    writeMetaBlock_(leaf[0], leaf_buf);
+    dir_fill_unit(leaf_buf, BLOCK_SIZE, recs, mid, recs.size());
+    writeMetaBlock_(fresh[0], leaf_buf);
+
+    memmove(&entries[slot + 2], &entries[slot + 1], (root->dx_count - slot - 1) * sizeof(DirIndexEntry));
+    entries[slot + 1].dx_hash = recs[mid].hash;
+    entries[slot + 1].dx_block = static_cast<uint32_t>(new_logical);
+    ++root->dx_count;
+    std::vector<int> root_block;
+    mapBlocks_(dir, 0, 1, false, root_block);
+    writeMetaBlock_(root_block[0], root_buf);
+    return 1;
+}
 
-    while (end != std::string::npos)
-    {
-        std::string component = p.substr(start, end - start);
-        current_inode = findInDir(current_inode, component);
-        if (current_inode < 0)
-            return -1;
-        Inode inode = readInode(current_inode);
-        if (inode.i_type != DIRECTORY)
-            return -1;
-        start = end + 1;
-        end = p.find('/', start);
+bool FileSystem::dxBuildIndex_(Inode &dir, int inode_id, const std::string &name, int type)
+{
+    if (super_block.s_free_blocks_count < 2)
+        return false;
+    std::vector<int> blocks;
+    if (mapBlocks_(dir, 0, 1, false, blocks) < 1)
+        return false;
+    int root_block = blocks[0];
+
+    char buf[BLOCK_SIZE];
+    cache.readBlock(root_block, buf);
+    std::vector<DirRecord> all;
+    dir_collect_unit(buf, BLOCK_SIZE, all);
+    int self_id = dir.i_id;
+    int parent_id = dir.i_id;
+    std::vector<DirRecord> recs;
+    for (DirRecord &r : all)
+    {
+        if (r.name == ".")
+            self_id = r.inode_id;
+        else if (r.name == "..")
+            parent_id = r.inode_id;
+        else
+            recs.push_back(std::move(r));
     }
+    recs.push_back({dir_name_hash(name.data(), name.size()), inode_id, type, name});
+    std::sort(recs.begin(), recs.end(), [](const DirRecord &a, const DirRecord &b) { return a.hash < b.hash; });
+    std::size_t mid = 0;
+    if (!dir_split_records(recs, &mid))
+        return false;
 
-    std::string last_component = p.substr(start);
-    return findInDir(current_inode, last_component);
+    // 原目录项分到逻辑块 1、2 两个叶子
+    if (mapBlocks_(dir, 1, 2, true, blocks) < 2)
+    {
+        // 空间检查过，正常不会走到这里；已分配的块作为空目录块留在目录里
+        for (int block_id : blocks)
+        {
+            dir_init_unit(buf, BLOCK_SIZE);
+            writeMetaBlock_(block_id, buf);
+        }
+        dir.i_size += static_cast<int>(blocks.size()) * BLOCK_SIZE;
+        return false;
+    }
+    char leaf_buf[BLOCK_SIZE];
+    dir_fill_unit(leaf_buf, BLOCK_SIZE, recs, 0, mid);
+    writeMetaBlock_(blocks[0], leaf_buf);
+    dir_fill_unit(leaf_buf, BLOCK_SIZE, recs, mid, recs.size());
+    writeMetaBlock_(blocks[1], leaf_buf);
+
+    // 第 0 块改写为索引根
+    memset(buf, 0, BLOCK_SIZE);
+    DirEntry *dot = reinterpret_cast<DirEntry *>(buf);
+    dot->d_inode_id = self_id;
+    dot->d_rec_len = static_cast<uint16_t>(dirRecLen(1));
+    dot->d_name_len = 1;
+    dot->d_type = DIRECTORY;
+    memcpy(buf + DIR_ENTRY_HEADER, ".", 1);
+    DirEntry *dotdot = reinterpret_cast<DirEntry *>(buf + dirRecLen(1));
+    dotdot->d_inode_id = parent_id;
+    dotdot->d_rec_len = static_cast<uint16_t>(DX_FAKE_OFFSET - dirRecLen(1));
+    dotdot->d_name_len = 2;
+    dotdot->d_type = DIRECTORY;
+    memcpy(buf + dirRecLen(1) + DIR_ENTRY_HEADER, "..", 2);
+    DirEntry *fake = reinterpret_cast<DirEntry *>(buf + DX_FAKE_OFFSET);
+    fake->d_inode_id = -1;
+    fake->d_rec_len = static_cast<uint16_t>(BLOCK_SIZE - DX_FAKE_OFFSET);
+    DirIndexRoot *root = dx_root(buf);
+    root->dx_magic = DIR_INDEX_MAGIC;
+    root->dx_count = 2;
+    root->dx_limit = static_cast<uint16_t>(DX_LIMIT);
+    DirIndexEntry *entries = dx_entries(buf);
+    entries[0].dx_hash = 0;
+    entries[0].dx_block = 1;
+    entries[1].dx_hash = recs[mid].hash;
+    entries[1].dx_block = 2;
+    writeMetaBlock_(root_block, buf);
+
+    dir.i_size = 3 * BLOCK_SIZE;
+    dir.i_flags |= INODE_DIR_INDEX;
+    dir_slot_hint_.erase(dir.i_id);
+    return true;
 }
 
-int FileSystem::findInDir(int dir_inode_id, const std::string &filename)
+bool FileSystem::forEachDirEntry_(const Inode &dir, const std::function<bool(const DirEntry &entry, const char *name)> &fn)
 {
-    Inode dir_inode = readInode(dir_inode_id);
-    if (dir_inode.i_type != DIRECTORY)
-        return -1;
+    if (dir.i_type != DIRECTORY)
+        return false;
+    if (dir.i_flags & INODE_INLINE_DATA)
+        return dir_scan_unit(dir.i_inline, INODE_INLINE_SIZE, fn);
 
+    // 目录没有空洞，i_size 为目录块数 * BLOCK_SIZE
+    std::vector<int> blocks;
+    mapBlocks_(const_cast<Inode &>(dir), 0, dir.i_size / BLOCK_SIZE, false, blocks);
     char block_buf[BLOCK_SIZE];
-    for (int i = 0; i < DIRECT_BLOCKS && dir_inode.i_direct[i] != -1; ++i)
+    for (int block_id : blocks)
     {
-        disk.readBlock(dir_inode.i_direct[i], block_buf);
-        DirEntry *entries = (DirEntry *)block_buf;
-        int entry_count = BLOCK_SIZE / sizeof(DirEntry);
-        for (int j = 0; j < entry_count; ++j)
-        {
-            if (entries[j].d_inode_id != -1 && strcmp(entries[j].d_name, filename.c_str()) == 0)
-            {
-                return entries[j].d_inode_id;
-            }
-        }
+        cache.readBlock(block_id, block_buf);
+        if (dir_scan_unit(block_buf, BLOCK_SIZE, fn))
+            return true;
     }
-    return -1;
+    return false;
 }
 
-bool FileSystem::addDirEntry(int dir_inode_id, const std::string &filename, int new_inode_id)
+void FileSystem::initDirectory_(Inode &dir, int self_id, int parent_id)
 {
-    Inode dir_inode = readInode(dir_inode_id);
-    char block_buf[BLOCK_SIZE];
+    memset(dir.i_map_area, 0, sizeof(dir.i_map_area));
+    dir.i_flags = INODE_INLINE_DATA;
+    dir.i_size = INODE_INLINE_SIZE;
+    dir.i_blocks = 0;
+    dir_init_unit(dir.i_inline, INODE_INLINE_SIZE);
+    dir_insert_unit(dir.i_inline, INODE_INLINE_SIZE, self_id, ".", DIRECTORY);
+    dir_insert_unit(dir.i_inline, INODE_INLINE_SIZE, parent_id, "..", DIRECTORY);
+}
+
+bool FileSystem::inlineDirToBlock_(Inode &dir)
+{
+    char saved[INODE_INLINE_SIZE];
+    memcpy(saved, dir.i_inline, sizeof(saved));
+    int saved_flags = dir.i_flags;
 
+    memset(dir.i_map_area, 0, sizeof(dir.i_map_area));
     for (int i = 0; i < DIRECT_BLOCKS; ++i)
+        dir.i_direct[i] = -1;
+    dir.i_indirect1 = -1;
+    dir.i_indirect2 = -1;
+    dir.i_flags &= ~INODE_INLINE_DATA;
+
+    std::vector<int> blocks;
+    if (mapBlocks_(dir, 0, 1, true, blocks) < 1)
     {
-        int block_id = dir_inode.i_direct[i];
-        if (block_id == -1)
-        {
-            block_id = allocDataBlock();
-            if (block_id < 0)
-                return false;
-            dir_inode.i_direct[i] = block_id;
-            dir_inode.i_blocks++;
-            memset(block_buf, 0, BLOCK_SIZE);
+        memcpy(dir.i_inline, saved, sizeof(saved));
+        dir.i_flags = saved_flags;
+        return false;
+    }
 
-            DirEntry *entries = reinterpret_cast<DirEntry *>(block_buf);
-            int entry_count = BLOCK_SIZE / sizeof(DirEntry);
-            for (int j = 0; j < entry_count; ++j)
-            {
-                entries[j].d_inode_id = -1;
-                entries[j].d_name[0] = '\0';
-            }
-        }
-        else
+    // 记录原样搬过去，最后一条记录吞下块内剩余的空间
+    char block_buf[BLOCK_SIZE];
+    memset(block_buf, 0, BLOCK_SIZE);
+    memcpy(block_buf, saved, sizeof(saved));
+    int off = 0;
+    while (off + DIR_ENTRY_HEADER <= INODE_INLINE_SIZE)
+    {
+        DirEntry *e = reinterpret_cast<DirEntry *>(block_buf + off);
+        if (!dir_entry_valid(e, off, INODE_INLINE_SIZE))
+            break;
+        if (off + e->d_rec_len == INODE_INLINE_SIZE)
         {
-            disk.readBlock(block_id, block_buf);
+            e->d_rec_len = static_cast<uint16_t>(e->d_rec_len + BLOCK_SIZE - INODE_INLINE_SIZE);
+            break;
         }
+        off += e->d_rec_len;
+    }
+    writeMetaBlock_(blocks[0], block_buf);
+    dir.i_size = BLOCK_SIZE;
+    return true;
+}
 
-        DirEntry *entries = reinterpret_cast<DirEntry *>(block_buf);
-        int entry_count = BLOCK_SIZE / sizeof(DirEntry);
-        for (int j = 0; j < entry_count; ++j)
+void FileSystem::upgradeDirectories_()
+{
+    char old_buf[BLOCK_SIZE];
+    char new_buf[BLOCK_SIZE];
+    const int legacy_count = BLOCK_SIZE / static_cast<int>(sizeof(LegacyDirEntry));
+    for (int inode_id = 0; inode_id < TOTAL_INODES; ++inode_id)
+    {
+        if (!inode_bitmap.test(inode_id))
+            continue;
+        Inode dir = readInode(inode_id);
+        if (dir.i_type != DIRECTORY || (dir.i_flags & INODE_INLINE_DATA))
+            continue;
+
+        // 每块最多 4 个定长目录项，转换后在同一块内一定放得下
+        int nblocks = 0;
+        for (; nblocks < DIRECT_BLOCKS && dir.i_direct[nblocks] != -1; ++nblocks)
         {
-            if (entries[j].d_inode_id == -1 || strlen(entries[j].d_name) == 0)
+            cache.readBlock(dir.i_direct[nblocks], old_buf);
+            const LegacyDirEntry *old_entries = reinterpret_cast<const LegacyDirEntry *>(old_buf);
+            dir_init_unit(new_buf, BLOCK_SIZE);
+            for (int j = 0; j < legacy_count; ++j)
             {
-                entries[j].d_inode_id = new_inode_id;
-                strcpy(entries[j].d_name, filename.c_str());
-                disk.writeBlock(block_id, block_buf);
-                dir_inode.i_size += sizeof(DirEntry);
-                dir_inode.i_mtime = dir_inode.i_atime = time(NULL);
-                writeInode(dir_inode_id, dir_inode);
-                return true;
+                if (old_entries[j].d_inode_id == -1 || old_entries[j].d_name[0] == '\0')
+                    continue;
+                std::string name(old_entries[j].d_name, strnlen(old_entries[j].d_name, sizeof(old_entries[j].d_name)));
+                int type = readInode(old_entries[j].d_inode_id).i_type;
+                dir_insert_unit(new_buf, BLOCK_SIZE, old_entries[j].d_inode_id, name, type);
             }
+            writeMetaBlock_(dir.i_direct[nblocks], new_buf);
         }
+        dir.i_size = nblocks * BLOCK_SIZE;
+        writeInode(inode_id, dir);
     }
-    return false; // 目录满了（简化）
 }
 
 bool FileSystem::removeDirEntry(int dir_inode_id, const std::string &filename)
 {
     Inode dir_inode = readInode(dir_inode_id);
-    char block_buf[BLOCK_SIZE];
+    if (dir_inode.i_type != DIRECTORY)
+        return false;
 
-    for (int i = 0; i < DIRECT_BLOCKS && dir_inode.i_direct[i] != -1; ++i)
+    bool removed = false;
+    char block_buf[BLOCK_SIZE];
+    if (dir_inode.i_flags & INODE_INLINE_DATA)
+    {
+        removed = dir_remove_unit(dir_inode.i_inline, INODE_INLINE_SIZE, filename);
+    }
+    else if ((dir_inode.i_flags & INODE_DIR_INDEX) && dxLoadRoot_(dir_inode, block_buf))
+    {
+        // 只需要看哈希对应的那个叶子
+        int slot = dx_find_slot(dx_entries(block_buf), dx_root(block_buf)->dx_count,
+                                dir_name_hash(filename.data(), filename.size()));
+        std::vector<int> leaf;
+        if (mapBlocks_(dir_inode, static_cast<int>(dx_entries(block_buf)[slot].dx_block), 1, false, leaf) == 1)
+        {
+            cache.readBlock(leaf[0], block_buf);
+            removed = dir_remove_unit(block_buf, BLOCK_SIZE, filename);
+            if (removed)
+                writeMetaBlock_(leaf[0], block_buf);
+        }
+    }
+    else
     {
-        disk.readBlock(dir_inode.i_direct[i], block_buf);
-        DirEntry *entries = reinterpret_cast<DirEntry *>(block_buf);
-        int entry_count = BLOCK_SIZE / sizeof(DirEntry);
-        for (int j = 0; j < entry_count; ++j)
+        std::vector<int> blocks;
+        mapBlocks_(dir_inode, 0, dir_inode.i_size / BLOCK_SIZE, false, blocks);
+        for (int idx = 0; idx < static_cast<int>(blocks.size()); ++idx)
         {
-            if (entries[j].d_inode_id != -1 && strcmp(entries[j].d_name, filename.c_str()) == 0)
+            cache.readBlock(blocks[idx], block_buf);
+            if (dir_remove_unit(block_buf, BLOCK_SIZE, filename))
             {
-                entries[j].d_inode_id = -1;
-                entries[j].d_name[0] = '\0';
-                disk.writeBlock(dir_inode.i_direct[i], block_buf);
-
-                if (dir_inode.i_size >= static_cast<int>(sizeof(DirEntry)))
-                    dir_inode.i_size -= sizeof(DirEntry);
-                dir_inode.i_mtime = dir_inode.i_atime = time(NULL);
-                writeInode(dir_inode_id, dir_inode);
-                return true;
+                writeMetaBlock_(blocks[idx], block_buf);
+                dir_slot_hint_[dir_inode_id] = idx; // 这一块刚空出位置
+                removed = true;
+                break;
             }
         }
     }
-    return false;
+    if (!removed)
+        return false;
+
+    dir_inode.i_mtime = dir_inode.i_atime = time(NULL);
+    writeInode(dir_inode_id, dir_inode);
+    dcacheSet_(dir_inode_id, filename, -1);
+    cwd_path_valid_ = false; // 被删的可能是当前目录路径上的某一级
+    return true;
 }
 
 // 其他函数如 removeFile, removeDirectory, freeInode, freeDataBlock 等的实现被省略
 // 它们需要递归地释放数据块和inode，并更新位图和超级块
 int FileSystem::removeFile(const std::string &path)
 {
+    OpScope op(*this);
     std::string filename;
     int parent_inode_id = resolvePath(path, filename);
     if (parent_inode_id < 0 || filename.empty())
@@ -807,13 +2509,12 @@ int FileSystem::removeFile(const std::string &path)
     if (!removeDirEntry(parent_inode_id, filename))
         std::cerr << "Warning: directory entry cleanup failed." << std::endl;
 
-    saveBitmaps();
-    saveSuperBlock();
     return 0;
 }
 
 int FileSystem::removeDirectory(const std::string &path)
 {
+    OpScope op(*this);
     if (path == "/" || path.empty())
     {
         std::cerr << "Error: cannot remove root directory." << std::endl;
@@ -854,22 +2555,21 @@ int FileSystem::removeDirectory(const std::string &path)
     if (!removeDirEntry(parent_inode_id, dirname))
         std::cerr << "Warning: directory entry cleanup failed." << std::endl;
 
-    saveBitmaps();
-    saveSuperBlock();
     return 0;
 }
 
-int FileSystem::alloc_fd_(const std::string &path, int flags, std::size_t offset)
+int FileSystem::alloc_fd_(int inode_id, int flags, std::size_t offset)
 {
+    iget_(inode_id); // sys_close 时 iput_
     for (int i = 0; i < static_cast<int>(fd_table_.size()); ++i)
     {
         if (!fd_table_[i].in_use)
         {
-            fd_table_[i] = FD{path, flags, offset, true};
+            fd_table_[i] = FD{inode_id, flags, offset, true};
             return i;
         }
     }
-    fd_table_.push_back(FD{path, flags, offset, true});
+    fd_table_.push_back(FD{inode_id, flags, offset, true});
     return static_cast<int>(fd_table_.size() - 1);
 }
 
@@ -878,6 +2578,14 @@ bool FileSystem::check_fd_(int fd) const
     return fd >= 0 && fd < static_cast<int>(fd_table_.size()) && fd_table_[fd].in_use;
 }
 
+bool FileSystem::check_fd_inode_(int fd) const
+{
+    if (!check_fd_(fd))
+        return false;
+    int inode_id = fd_table_[fd].inode_id;
+    return inode_id >= 0 && inode_id < TOTAL_INODES && inode_bitmap.test(inode_id);
+}
+
 // 下面这些 fs_* 方法是“适配层”，请用你已有的底层实现替换
 // 例如：touch/echo/cat/ls 对应的内部方法。若名字不同，替换调用即可。
 bool FileSystem::fs_path_exists_(const std::string &path, bool *is_dir) const
@@ -896,61 +2604,6 @@ bool FileSystem::fs_create_file_(const std::string &path)
     return createFile(path) >= 0;
 }
 
-bool FileSystem::fs_read_file_all_(const std::string &path, std::string &out) const
-{
-    auto *self = const_cast<FileSystem *>(this);
-    int inode_id = self->findInodeByPath(path);
-    if (inode_id < 0)
-        return false;
-    Inode inode = self->readInode(inode_id);
-    if (inode.i_type != REGULAR_FILE)
-        return false;
-
-    out.clear();
-    out.reserve(static_cast<std::size_t>(std::max(0, inode.i_size)));
-
-    char block_buf[BLOCK_SIZE];
-    int remaining = inode.i_size;
-    while (remaining > 0)
-    {
-        int block_index = static_cast<int>(out.size() / BLOCK_SIZE);
-        if (block_index >= DIRECT_BLOCKS)
-            break;
-        int block_id = inode.i_direct[block_index];
-        if (block_id == -1)
-            break;
-
-        self->disk.readBlock(block_id, block_buf);
-        int copy_len = std::min(remaining, BLOCK_SIZE);
-        out.append(block_buf, block_buf + copy_len);
-        remaining -= copy_len;
-    }
-    return remaining == 0;
-}
-
-bool FileSystem::fs_write_file_all_(const std::string &path, const std::string &data, bool truncate)
-{
-    int inode_id = findInodeByPath(path);
-    if (inode_id < 0)
-    {
-        inode_id = createFile(path);
-        if (inode_id < 0)
-            return false;
-    }
-    Inode inode = readInode(inode_id);
-    if (inode.i_type != REGULAR_FILE)
-        return false;
-
-    if (truncate)
-        truncateFileData_(inode);
-
-    int written = writeFile(inode_id, data.data(), static_cast<int>(data.size()), 0);
-    bool ok = (written == static_cast<int>(data.size()));
-    saveBitmaps();
-    saveSuperBlock();
-    return ok;
-}
-
 bool FileSystem::fs_mkdir_(const std::string &path)
 {
     return createDirectory(path) >= 0;
@@ -977,18 +2630,11 @@ bool FileSystem::fs_list_dir_(const std::string &path, std::vector<std::string>
     if (inode.i_type != DIRECTORY)
         return false;
 
-    char block_buf[BLOCK_SIZE];
-    for (int i = 0; i < DIRECT_BLOCKS && inode.i_direct[i] != -1; ++i)
+    self->forEachDirEntry_(inode, [&entries](const DirEntry &entry, const char *entry_name)
     {
-        self->disk.readBlock(inode.i_direct[i], block_buf);
-        const DirEntry *dir_entries = reinterpret_cast<const DirEntry *>(block_buf);
-        int entry_count = BLOCK_SIZE / sizeof(DirEntry);
-        for (int j = 0; j < entry_count; ++j)
-        {
-            if (dir_entries[j].d_inode_id != -1 && dir_entries[j].d_name[0] != '\0')
-                entries.emplace_back(dir_entries[j].d_name);
-        }
-    }
+        entries.emplace_back(entry_name, entry.d_name_len);
+        return false;
+    });
     return true;
 }
 
@@ -996,6 +2642,7 @@ bool FileSystem::fs_list_dir_(const std::string &path, std::vector<std::string>
 
 int FileSystem::sys_create(const std::string &path)
 {
+    OpScope op(*this);
     bool is_dir = false;
     if (fs_path_exists_(path, &is_dir))
         return -1; // 已存在
@@ -1004,6 +2651,7 @@ int FileSystem::sys_create(const std::string &path)
 
 int FileSystem::sys_open(const std::string &path, int flags)
 {
+    OpScope op(*this);
     bool is_dir = false;
     if (!fs_path_exists_(path, &is_dir))
     {
@@ -1020,90 +2668,274 @@ int FileSystem::sys_open(const std::string &path, int flags)
     if (is_dir)
         return -1; // 不允许把目录当文件打开
 
-    std::size_t offset = 0;
-    if (flags & O_APPEND)
-    {
-        std::string content;
-        if (!fs_read_file_all_(path, content))
-            return -1;
-        offset = content.size();
-    }
+    int inode_id = findInodeByPath(path);
+    if (inode_id < 0)
+        return -1;
+    Inode inode = readInode(inode_id);
     if (flags & O_TRUNC)
-    {
-        if (!fs_write_file_all_(path, "", true))
-            return -1;
-        offset = 0;
-    }
-    return alloc_fd_(path, flags, offset);
+        truncateFileData_(inode);
+    // O_APPEND 每次写之前还会重新定位到文件末尾
+    std::size_t offset = (flags & O_APPEND) ? static_cast<std::size_t>(inode.i_size) : 0;
+    return alloc_fd_(inode_id, flags, offset);
 }
 
 std::ptrdiff_t FileSystem::sys_read(int fd, std::string &out, std::size_t count)
 {
-    if (!check_fd_(fd))
+    out.clear();
+    if (!check_fd_inode_(fd))
         return -1;
     auto &f = fd_table_[fd];
-    if (!(f.flags & O_RDONLY) && !(f.flags & O_RDWR))
+    if (!(f.flags & O_RDONLY)) // O_RDWR 同时含读写两位
         return -1;
+    // 先按文件剩余长度截断再分配缓冲区，count 很大 (例如"读到末尾") 时不会按 count 分配
+    std::size_t file_size = static_cast<std::size_t>(std::max(0, readInode(f.inode_id).i_size));
+    if (f.offset >= file_size)
+        return 0;
+    count = std::min(count, file_size - f.offset);
+    out.resize(count);
+    std::ptrdiff_t n = sys_pread(fd, &out[0], count, f.offset);
+    out.resize(n > 0 ? static_cast<std::size_t>(n) : 0);
+    if (n > 0)
+        f.offset += n;
+    return n;
+}
 
-    std::string content;
-    if (!fs_read_file_all_(f.path, content))
+std::ptrdiff_t FileSystem::sys_write(int fd, const std::string &data)
+{
+    OpScope op(*this);
+    if (!check_fd_inode_(fd))
         return -1;
-    if (f.offset >= content.size())
-    {
-        out.clear();
+    auto &f = fd_table_[fd];
+    if (f.flags & O_APPEND)
+        f.offset = static_cast<std::size_t>(readInode(f.inode_id).i_size);
+    std::ptrdiff_t n = sys_pwrite(fd, data.data(), data.size(), f.offset);
+    if (n > 0)
+        f.offset += n;
+    return n;
+}
+
+std::ptrdiff_t FileSystem::sys_pread(int fd, char *buf, std::size_t count, std::size_t offset)
+{
+    if (!check_fd_inode_(fd))
+        return -1;
+    const auto &f = fd_table_[fd];
+    if (!(f.flags & O_RDONLY)) // O_RDWR 同时含读写两位
+        return -1;
+
+    // 只读 [offset, offset + count) 涉及的块
+    if (count == 0 || offset >= static_cast<std::size_t>(INT_MAX))
         return 0;
-    }
-    std::size_t n = std::min(count, content.size() - f.offset);
-    out.assign(content.data() + f.offset, n);
-    f.offset += n;
-    return static_cast<std::ptrdiff_t>(n);
+    count = std::min(count, static_cast<std::size_t>(INT_MAX) - offset);
+    return readFile(f.inode_id, buf, static_cast<int>(count), static_cast<int>(offset));
 }
 
-std::ptrdiff_t FileSystem::sys_write(int fd, const std::string &data)
+std::ptrdiff_t FileSystem::sys_pwrite(int fd, const char *buf, std::size_t count, std::size_t offset)
 {
-    if (!check_fd_(fd))
+    OpScope op(*this);
+    if (!check_fd_inode_(fd))
+        return -1;
+    const auto &f = fd_table_[fd];
+    if (!(f.flags & O_WRONLY))
+        return -1;
+    if (count == 0)
+        return 0;
+    if (offset > static_cast<std::size_t>(INT_MAX) || count > static_cast<std::size_t>(INT_MAX) - offset)
+        return -1;
+
+    // 只改写 [offset, offset + count) 涉及的块；offset 超过文件末尾时中间留下空洞，读出为 0
+    int n = writeFile(f.inode_id, buf, static_cast<int>(count), static_cast<int>(offset));
+    return n > 0 ? n : -1;
+}
+
+long FileSystem::sys_lseek(int fd, long offset, int whence)
+{
+    if (!check_fd_inode_(fd))
         return -1;
     auto &f = fd_table_[fd];
-    if (!(f.flags & O_WRONLY) && !(f.flags & O_RDWR))
+    long base = 0;
+    switch (whence)
+    {
+    case FS_SEEK_SET:
+        base = 0;
+        break;
+    case FS_SEEK_CUR:
+        base = static_cast<long>(f.offset);
+        break;
+    case FS_SEEK_END:
+        base = readInode(f.inode_id).i_size;
+        break;
+    case FS_SEEK_DATA:
+    case FS_SEEK_HOLE:
+    {
+        // 从 offset 起找下一段数据 / 下一个空洞；文件末尾视为空洞，offset 不在文件内时失败
+        const Inode inode = readInode(f.inode_id);
+        if (offset < 0 || offset >= inode.i_size)
+            return -1;
+        long pos = offset;
+        if (!(inode.i_flags & INODE_INLINE_DATA))
+        {
+            int end = (inode.i_size + BLOCK_SIZE - 1) / BLOCK_SIZE;
+            int b = nextMapped_(inode, static_cast<int>(offset / BLOCK_SIZE), end, whence == FS_SEEK_DATA);
+            if (whence == FS_SEEK_DATA && b >= end)
+                return -1; // offset 之后只有空洞
+            pos = std::max(offset, static_cast<long>(b) * BLOCK_SIZE);
+        }
+        else if (whence == FS_SEEK_HOLE)
+        {
+            pos = inode.i_size;
+        }
+        if (whence == FS_SEEK_HOLE)
+            pos = std::min(pos, static_cast<long>(inode.i_size));
+        f.offset = static_cast<std::size_t>(pos);
+        return pos;
+    }
+    default:
         return -1;
+    }
+    // base 不为负，只有正向偏移可能溢出
+    if (offset > 0 && base > LONG_MAX - offset)
+        return -1;
+    long pos = base + offset;
+    if (pos < 0)
+        return -1;
+    f.offset = static_cast<std::size_t>(pos);
+    return pos;
+}
 
-    std::string content;
-    if (!fs_read_file_all_(f.path, content))
-        content.clear();
+int FileSystem::sys_fstat(int fd, FileStat &st)
+{
+    if (!check_fd_inode_(fd))
+        return -1;
+    const Inode inode = readInode(fd_table_[fd].inode_id);
+    st.ino = inode.i_id;
+    st.type = inode.i_type;
+    st.size = static_cast<std::size_t>(inode.i_size);
+    st.blocks = inode.i_blocks;
+    st.atime = inode.i_atime;
+    st.mtime = inode.i_mtime;
+    st.ctime = inode.i_ctime;
+    return 0;
+}
 
-    // 处理写入位置：覆盖/追加/中间写（简化为覆盖构造）
-    if (f.flags & O_APPEND)
-        f.offset = content.size();
+int FileSystem::sys_fsync(int fd)
+{
+    if (!check_fd_inode_(fd))
+        return -1;
+    // lazytime 下只改了时间戳的 inode 平时不写回，fsync 要求它也落盘
+    auto it = icache_.find(fd_table_[fd].inode_id);
+    if (it != icache_.end() && it->second.time_dirty)
+        it->second.dirty = true;
+    writeBackAll_(false);
+    return 0;
+}
+
+int FileSystem::sys_fdatasync(int fd)
+{
+    if (!check_fd_inode_(fd))
+        return -1;
+    writeBackAll_(false);
+    return 0;
+}
+
+int FileSystem::sys_fallocate(int fd, std::size_t offset, std::size_t len, int mode)
+{
+    OpScope op(*this);
+    if (!check_fd_inode_(fd))
+        return -1;
+    const auto &f = fd_table_[fd];
+    if (!(f.flags & O_WRONLY))
+        return -1;
+    if (mode & ~(FS_FALLOC_KEEP_SIZE | FS_FALLOC_ZERO_RANGE))
+        return -1;
+    if (len == 0 || offset > static_cast<std::size_t>(INT_MAX) || len > static_cast<std::size_t>(INT_MAX) - offset)
+        return -1;
 
-    // 扩展到 offset
-    if (f.offset > content.size())
-        content.resize(f.offset, '\0');
-    // 在 offset 处写入 data（覆盖）
-    if (f.offset + data.size() > content.size())
+    Inode inode = readInode(f.inode_id);
+    if (inode.i_type != REGULAR_FILE)
+        return -1;
+    int begin = static_cast<int>(offset);
+    int end = static_cast<int>(offset + len);
+    if ((inode.i_flags & INODE_INLINE_DATA) && !inlineToBlocks_(inode))
     {
-        content.replace(f.offset, std::string::npos, data);
+        std::cerr << "Error: No space left on device." << std::endl;
+        return -1;
     }
-    else
+
+    int first_block = begin / BLOCK_SIZE;
+    int count = (end - 1) / BLOCK_SIZE - first_block + 1;
+    std::vector<int> before;
+    mapRange_(inode, first_block, count, before);
+    int high_water = (super_block.s_flags & SB_LAZY_INIT) ? super_block.s_data_high_water : DISK_BLOCKS;
+    std::vector<int> blocks;
+    int mapped = mapBlocks_(inode, first_block, count, true, blocks);
+
+    // 新分配的块：从未写过的块在磁盘上本来就是 0，prepareNewBlock_ 放的干净 0 块不必占缓存；
+    // 用过的块保留缓存中的脏 0 块，随数据在提交前写回 (不能直接打洞：本操作提交之前崩溃时，
+    // 磁盘上的一致状态里这些块的内容仍可能被引用)
+    std::vector<int> zero_full;
+    char block_buf[BLOCK_SIZE];
+    for (int i = 0; i < mapped; ++i)
+    {
+        if (before[i] < 0)
+        {
+            if (blocks[i] >= high_water)
+                cache.discard(blocks[i]);
+            else
+                data_dirty_ = true;
+            continue;
+        }
+        if (!(mode & FS_FALLOC_ZERO_RANGE))
+            continue;
+        int block_start = (first_block + i) * BLOCK_SIZE;
+        int lo = std::max(begin, block_start) - block_start;
+        int hi = std::min(end, block_start + BLOCK_SIZE) - block_start;
+        if (lo == 0 && hi == BLOCK_SIZE)
+        {
+            zero_full.push_back(blocks[i]);
+            continue;
+        }
+        cache.readBlock(blocks[i], block_buf);
+        memset(block_buf + lo, 0, hi - lo);
+        cache.writeBlock(blocks[i], block_buf);
+    }
+    if (!zero_full.empty())
     {
-        content.replace(f.offset, data.size(), data);
+        // 已有数据的块可能被只读视图钉住，清零要经过缓存
+        std::vector<char> zeros(zero_full.size() * BLOCK_SIZE, 0);
+        cache.writeBlocks(zero_full, zeros.data());
+        data_dirty_ = true;
     }
-    f.offset += data.size();
 
-    if (!fs_write_file_all_(f.path, content, /*truncate*/ true))
+    // 失败时文件长度不变 (已分配的块留作预留，长度之外的块读不到)
+    if (mapped == count && !(mode & FS_FALLOC_KEEP_SIZE))
+        inode.i_size = std::max(inode.i_size, end);
+    inode.i_mtime = time(NULL);
+    writeInode(inode.i_id, inode);
+
+    if (mapped < count)
+    {
+        if (super_block.s_free_blocks_count <= 0)
+            std::cerr << "Error: No space left on device." << std::endl;
+        else
+            std::cerr << "Error: File size exceeds block map limit (simplification)." << std::endl;
         return -1;
-    return static_cast<std::ptrdiff_t>(data.size());
+    }
+    return 0;
 }
 
 int FileSystem::sys_close(int fd)
 {
+    OpScope op(*this);
     if (!check_fd_(fd))
         return -1;
+    iput_(fd_table_[fd].inode_id);
     fd_table_[fd] = FD{}; // 置空
     return 0;
 }
 
 int FileSystem::sys_mkdir(const std::string &path)
 {
+    OpScope op(*this);
     bool is_dir = false;
     if (fs_path_exists_(path, &is_dir))
         return -1;
@@ -1112,6 +2944,7 @@ int FileSystem::sys_mkdir(const std::string &path)
 
 int FileSystem::sys_rmdir(const std::string &path)
 {
+    OpScope op(*this);
     bool is_dir = false;
     if (!fs_path_exists_(path, &is_dir) || !is_dir)
         return -1;
@@ -1120,6 +2953,7 @@ int FileSystem::sys_rmdir(const std::string &path)
 
 int FileSystem::sys_rm(const std::string &path)
 {
+    OpScope op(*this);
     bool is_dir = false;
     if (!fs_path_exists_(path, &is_dir) || is_dir)
         return -1;
@@ -1136,6 +2970,7 @@ int FileSystem::sys_ls(const std::string &path)
 // 如果路径不存在则创建，再返回其 inode id
 int FileSystem::openFile(const std::string &path)
 {
+    OpScope op(*this);
     int inode_id = findInodeByPath(path);
     if (inode_id < 0)
     {
@@ -1144,13 +2979,14 @@ int FileSystem::openFile(const std::string &path)
             return -1;
         inode_id = findInodeByPath(path);
     }
+    if (inode_id >= 0)
+        iget_(inode_id); // 打开期间固定在 inode 缓存中
     return inode_id;
 }
 
-// 简化实现：当前无需状态，直接返回
-void FileSystem::closeFile(int /*inode_id*/)
+void FileSystem::closeFile(int inode_id)
 {
-    // no-op in this simplified FS
+    iput_(inode_id);
 }
 
 // 释放一个 inode（更新位图与超级块，并清空该 inode）
@@ -1158,10 +2994,12 @@ void FileSystem::freeInode(int inode_id)
 {
     if (inode_id < 0 || inode_id >= super_block.s_total_inodes)
         return;
-    if (!inode_bitmap[inode_id])
+    if (!inode_bitmap.test(inode_id))
         return;
 
-    inode_bitmap[inode_id] = false;
+    inode_bitmap.clear(inode_id);
+    dir_slot_hint_.erase(inode_id);
+    dcacheDropDir_(inode_id);
     if (super_block.s_free_inodes_count < super_block.s_total_inodes)
     {
         ++super_block.s_free_inodes_count;
@@ -1174,23 +3012,22 @@ void FileSystem::freeInode(int inode_id)
     z.i_blocks = 0;
     z.i_atime = z.i_mtime = z.i_ctime = 0;
     z.i_indirect1 = -1;
+    z.i_indirect2 = -1;
     for (int i = 0; i < DIRECT_BLOCKS; ++i)
         z.i_direct[i] = -1;
+    z.i_flags = 0;
 
     writeInode(inode_id, z);
-    saveBitmaps();
-    saveSuperBlock();
 }
 
 void FileSystem::truncateFileData_(Inode &inode)
 {
-    for (int i = 0; i < DIRECT_BLOCKS; ++i)
+    releaseBlocks_(inode);
+    if (inode.i_type == REGULAR_FILE)
     {
-        if (inode.i_direct[i] != -1)
-        {
-            freeDataBlock(inode.i_direct[i]);
-            inode.i_direct[i] = -1;
-        }
+        // 空文件重新内联；块映射留下的 -1 要清掉，内联区 i_size 之后必须为 0 (空洞读出 0)
+        inode.i_flags = (inode.i_flags & ~INODE_EXTENTS) | INODE_INLINE_DATA;
+        memset(inode.i_map_area, 0, sizeof(inode.i_map_area));
     }
     inode.i_blocks = 0;
     inode.i_size = 0;
@@ -1202,23 +3039,13 @@ bool FileSystem::directoryIsEmpty_(const Inode &inode) const
 {
     if (inode.i_type != DIRECTORY)
         return false;
-    char block_buf[BLOCK_SIZE];
     auto *self = const_cast<FileSystem *>(this);
-    for (int i = 0; i < DIRECT_BLOCKS && inode.i_direct[i] != -1; ++i)
+    bool has_child = self->forEachDirEntry_(inode, [](const DirEntry &entry, const char *entry_name)
     {
-        self->disk.readBlock(inode.i_direct[i], block_buf);
-        const DirEntry *entries = reinterpret_cast<const DirEntry *>(block_buf);
-        int entry_count = BLOCK_SIZE / sizeof(DirEntry);
-        for (int j = 0; j < entry_count; ++j)
-        {
-            if (entries[j].d_inode_id == -1 || entries[j].d_name[0] == '\0')
-                continue;
-            if (strcmp(entries[j].d_name, ".") == 0 || strcmp(entries[j].d_name, "..") == 0)
-                continue;
-            return false;
-        }
-    }
-    return true;
+        std::string name(entry_name, entry.d_name_len);
+        return name != "." && name != "..";
+    });
+    return !has_child;
 }
 
 #if 0
@@ -281,6 +281,7 @@ int main()
         if (SDL_GetTicks() - last_tick > TICK_INTERVAL)
         {
             scheduler.tick();
+            fs.tick(); // PERIODIC 持久化策略的定时落盘
             last_tick = SDL_GetTicks();
         }
 
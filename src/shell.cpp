@@ -24,6 +24,40 @@ static int parse_int(const std::string &s)
     }
 }
 
+// 解析逗号分隔的挂载选项 (strictatime/relatime/noatime/lazytime/nolazytime/sync/flush[=毫秒]/noflush)，遇到未知选项返回 false
+static bool parse_mount_options(const std::string &s, MountOptions &opts)
+{
+    std::stringstream ss(s);
+    std::string opt;
+    while (std::getline(ss, opt, ','))
+    {
+        if (opt == "strictatime")
+            opts.atime = AtimeMode::STRICT;
+        else if (opt == "relatime")
+            opts.atime = AtimeMode::RELATIME;
+        else if (opt == "noatime")
+            opts.atime = AtimeMode::NOATIME;
+        else if (opt == "lazytime")
+            opts.lazytime = true;
+        else if (opt == "nolazytime")
+            opts.lazytime = false;
+        else if (opt == "sync")
+            opts.flush = FlushPolicy::SYNC;
+        else if (opt == "flush")
+            opts.flush = FlushPolicy::PERIODIC;
+        else if (opt.compare(0, 6, "flush=") == 0 && parse_int(opt.substr(6)) > 0)
+        {
+            opts.flush = FlushPolicy::PERIODIC;
+            opts.flush_interval_ms = parse_int(opt.substr(6));
+        }
+        else if (opt == "noflush")
+            opts.flush = FlushPolicy::UNMOUNT;
+        else if (!opt.empty())
+            return false;
+    }
+    return true;
+}
+
 Shell::Shell(FileSystem *fs) : fs(fs) {}
 
 void Shell::run()
@@ -181,6 +215,73 @@ void Shell::executeCommand(const std::string &command_line)
     {
         handle_exit(parts);
     }
+    else if (command == "sync")
+    {
+        fs->sync();
+    }
+    else if (command == "mount")
+    {
+        // mount [-o 选项]：查看或修改挂载选项
+        if (parts.size() >= 3 && parts[1] == "-o")
+        {
+            MountOptions opts = fs->mountOptions();
+            if (!parse_mount_options(parts[2], opts))
+                std::cerr << "mount: unknown option in '" << parts[2] << "'" << std::endl;
+            else
+                fs->setMountOptions(opts);
+        }
+        const MountOptions &opts = fs->mountOptions();
+        const char *atime = opts.atime == AtimeMode::STRICT ? "strictatime" : opts.atime == AtimeMode::NOATIME ? "noatime" : "relatime";
+        std::cout << "options: " << atime << (opts.lazytime ? ",lazytime" : "");
+        if (opts.flush == FlushPolicy::SYNC)
+            std::cout << ",sync";
+        else if (opts.flush == FlushPolicy::PERIODIC)
+            std::cout << ",flush=" << opts.flush_interval_ms;
+        else
+            std::cout << ",noflush";
+        std::cout << std::endl;
+    }
+    else if (command == "cachestat")
+    {
+        const auto &st = fs->cacheStats();
+        std::size_t total = st.hits + st.misses;
+        std::cout << "blocks: " << fs->cacheSize() << "/" << fs->cacheCapacity()
+                  << "  hits: " << st.hits << "  misses: " << st.misses
+                  << "  hit rate: " << (total ? st.hits * 100 / total : 0) << "%"
+                  << "  writebacks: " << st.writebacks << "  evictions: " << st.evictions << std::endl;
+        std::cout << "inodes: " << fs->inodeCacheSize() << "/" << INODE_CACHE_ENTRIES << std::endl;
+        const auto &dst = fs->dentryStats();
+        std::cout << "dentries: " << fs->dentryCacheSize() << "/" << DENTRY_CACHE_ENTRIES
+                  << "  hits: " << dst.hits << "  misses: " << dst.misses << std::endl;
+    }
+    else if (command == "iostat")
+    {
+        // iostat [depth]：查看异步引擎统计，或设置队列深度 (0 关闭)
+        if (parts.size() >= 2)
+        {
+            int depth = parse_int(parts[1]);
+            if (depth < 0)
+            {
+                std::cout << "usage: iostat [depth]\n";
+                return;
+            }
+            fs->setAsyncQueueDepth(static_cast<unsigned>(depth));
+        }
+        const AsyncIOEngine *engine = fs->asyncEngine();
+        if (!engine)
+        {
+            std::cout << "async engine: off" << std::endl;
+        }
+        else
+        {
+            const auto &st = engine->stats();
+            std::cout << "async engine: " << (engine->usingIoUring() ? "io_uring" : "thread pool")
+                      << "  depth: " << engine->queueDepth()
+                      << "  submitted: " << st.submitted << "  completed: " << st.completed
+                      << "  failed: " << st.failed << "  batches: " << st.batches
+                      << "  avg latency: " << st.avgLatencyUs() << "us  max: " << st.max_latency_us << "us" << std::endl;
+        }
+    }
     else if (command == "create")
     {
         if (parts.size() < 2)
@@ -256,6 +357,32 @@ void Shell::executeCommand(const std::string &command_line)
             std::cout << (rc == 0 ? "ok\n" : "err\n");
         }
     }
+    else if (command == "fallocate")
+    {
+        if (parts.size() < 4)
+        {
+            std::cout << "usage: fallocate <fd> <offset> <len> [mode]\n";
+        }
+        else
+        {
+            int mode = parts.size() >= 5 ? parse_int(parts[4]) : 0; // 1=KEEP_SIZE | 2=ZERO_RANGE
+            int rc = fs->sys_fallocate(parse_int(parts[1]), static_cast<std::size_t>(parse_int(parts[2])),
+                                       static_cast<std::size_t>(parse_int(parts[3])), mode);
+            std::cout << (rc == 0 ? "ok\n" : "err\n");
+        }
+    }
+    else if (command == "fsync")
+    {
+        if (parts.size() < 2)
+        {
+            std::cout << "usage: fsync <fd>\n";
+        }
+        else
+        {
+            int rc = fs->sys_fsync(parse_int(parts[1]));
+            std::cout << (rc == 0 ? "ok\n" : "err\n");
+        }
+    }
     else
     {
         std::cerr << "Unknown command: " << command << std::endl;
@@ -385,13 +512,19 @@ void Shell::handle_cat(const std::vector<std::string> &args)
         return;
     }
 
-    char buffer[4096]; // 一次最多读4KB
-    int bytes_read = fs->readFile(inode_id, buffer, sizeof(buffer) - 1, 0);
-    if (bytes_read > 0)
-    {
-        buffer[bytes_read] = '\0';
-        std::cout << buffer << std::endl;
-    }
+    // 逐段取只读视图直接输出，整个文件都不经过中间缓冲区
+    FileReadView view;
+    for (int offset = 0;;)
+    {
+        int n = fs->readView(inode_id, offset, READ_VIEW_BYTES, view);
+        if (n <= 0)
+            break;
+        for (std::string_view seg : view.segments())
+            std::cout.write(seg.data(), static_cast<std::streamsize>(seg.size()));
+        offset += n;
+    }
+    view.release();
+    std::cout << std::endl;
     fs->closeFile(inode_id);
 }
 
@@ -423,6 +556,14 @@ void Shell::handle_help(const std::vector<std::string> &args)
     std::cout << "  cat <filename>      - Displays file content." << std::endl;
     std::cout << "  rm <filename>       - Removes a file (not fully implemented)." << std::endl;
     std::cout << "  rmdir <dirname>     - Removes an empty directory (not fully implemented)." << std::endl;
+    std::cout << "  sync                - Flushes cached blocks to the disk." << std::endl;
+    std::cout << "  fsync <fd>          - Flushes a file's data and metadata to disk." << std::endl;
+    std::cout << "  fallocate <fd> <off> <len> [mode]" << std::endl;
+    std::cout << "                      - Preallocates blocks (mode: 1=KEEP_SIZE, 2=ZERO_RANGE)." << std::endl;
+    std::cout << "  mount [-o opts]     - Shows or sets mount options (strictatime, relatime, noatime, lazytime," << std::endl;
+    std::cout << "                        sync, flush[=ms], noflush)." << std::endl;
+    std::cout << "  cachestat           - Shows block, inode and dentry cache statistics." << std::endl;
+    std::cout << "  iostat [depth]      - Shows async I/O statistics or sets queue depth." << std::endl;
     std::cout << "  help                - Shows this help message." << std::endl;
     std::cout << "  exit                - Exits the shell." << std::endl;
 }